@@ -0,0 +1,10 @@
+#pragma once
+
+#include <wut.h>
+
+/**
+ * The host has no split caches, code is never executed natively (see HostSimulator::call).
+ */
+static inline void OSMemoryBarrier() {
+    __sync_synchronize();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <wut.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Prints to stdout.
+ */
+void OSReport(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Prints the message and aborts.
+ */
+void OSFatal(const char *msg) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
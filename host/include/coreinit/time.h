@@ -0,0 +1,20 @@
+#pragma once
+
+#include <wut.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * On the host a tick is a nanosecond of a monotonic clock.
+ */
+typedef int64_t OSTime;
+
+OSTime OSGetTime();
+
+#define OSTicksToMicroseconds(val) ((val) / 1000)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <wut.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void WHBLogPrintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+void WHBLogWritef(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#ifdef __cplusplus
+}
+#endif
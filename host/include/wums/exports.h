@@ -0,0 +1,4 @@
+#pragma once
+
+// The host binary calls the exports directly.
+#define WUMS_EXPORT_FUNCTION(function)
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+// The layout checks are for the 32 bit console ABI, the host uses 64 bit pointers.
+#define WUT_CHECK_OFFSET(type, offset, field)
+#define WUT_CHECK_SIZE(type, size)
+
+#define WUT_PP_CAT_INNER(a, b) a##b
+#define WUT_PP_CAT(a, b)       WUT_PP_CAT_INNER(a, b)
+#define WUT_UNKNOWN_BYTES(num) uint8_t WUT_PP_CAT(__unk, __COUNTER__)[num]
+#define WUT_PACKED             __attribute__((__packed__))
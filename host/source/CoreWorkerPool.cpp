@@ -0,0 +1,21 @@
+#include "utils/CoreWorkerPool.h"
+
+// The host has a single "core", the callback is run once for each core of the console.
+static constexpr uint32_t CORE_COUNT = 3;
+
+bool CoreWorkerPool::start() {
+    return true;
+}
+
+void CoreWorkerPool::stop() {
+}
+
+bool CoreWorkerPool::isRunning() {
+    return true;
+}
+
+void CoreWorkerPool::runOnAllCores(Callback callback, void *arg) {
+    for (uint32_t i = 0; i < CORE_COUNT; i++) {
+        callback(arg);
+    }
+}
@@ -0,0 +1,36 @@
+#include "HostApplication.h"
+#include "HostSimulator.h"
+#include "function_patcher.h"
+#include "utils/globals.h"
+#include "utils/utils.h"
+#include <coreinit/debug.h>
+#include <cstdlib>
+#include <cstring>
+
+void HostApplication::initialize() {
+    // Addresses are stored as uint32_t, see the Makefile.
+    auto *probe = malloc(1);
+    if ((uintptr_t) probe > 0xFFFFFFFF) {
+        OSFatal("HostApplication: The host heap is not below 4 GiB");
+    }
+    free(probe);
+
+    memset(gJumpHeapData, 0, JUMP_HEAP_DATA_SIZE);
+    if (!gTrampolineHeap.addArena(gJumpHeapData, JUMP_HEAP_DATA_SIZE)) {
+        OSFatal("HostApplication: Failed to create heap for jump data");
+    }
+
+    gFunctionAddressProvider = make_shared_nothrow<FunctionAddressProvider>(&gLoadedRPLs);
+    if (!gFunctionAddressProvider) {
+        OSFatal("HostApplication: Failed to create gFunctionAddressProvider");
+    }
+}
+
+void HostApplication::start(uint32_t upid, uint64_t titleId, std::optional<uint16_t> titleVersion) {
+    HostSimulator::setProcess(upid, titleId, titleVersion);
+    OnApplicationStarts();
+}
+
+void HostApplication::end() {
+    OnApplicationEnds();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+/**
+ * Does what the WUMS hooks in main.cpp do on the console.
+ */
+class HostApplication {
+public:
+    /**
+     * WUMS_INITIALIZE, once per run.
+     */
+    static void initialize();
+
+    /**
+     * WUMS_APPLICATION_STARTS, at least one module has to be loaded.
+     * Patches of executables of the title need its version.
+     */
+    static void start(uint32_t upid, uint64_t titleId, std::optional<uint16_t> titleVersion = {});
+
+    /**
+     * WUMS_APPLICATION_ENDS.
+     */
+    static void end();
+};
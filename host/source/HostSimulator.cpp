@@ -0,0 +1,295 @@
+#include "HostSimulator.h"
+#include "CallCounter.h"
+#include "TrampolineVerifier.h"
+#include "utils/PPCInstructions.h"
+#include "utils/globals.h"
+#include <algorithm>
+#include <coreinit/debug.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" char __executable_start[];
+extern "C" char _end[];
+
+typedef struct HostModule {
+    std::string name;
+    uint32_t textAddr;
+    std::vector<HostFunction> functions;
+    std::vector<std::string> functionNames;
+} HostModule;
+
+static std::vector<std::unique_ptr<HostModule>> sModules;
+// Kept so the handles and names that have been handed out stay valid (and unique).
+static std::vector<std::unique_ptr<HostModule>> sUnloadedModules;
+static uint32_t sNextModuleAddress = HostSimulator::MODULE_BASE;
+
+// Physical memory of the modules, a word that has never been written reads as 0.
+static std::map<uint32_t, uint32_t> sPhysicalMemory;
+static std::map<uint32_t, uint32_t> sPhysicalWrites;
+
+// The heap of the module is in low memory on the console, the arenas the TrampolineHeap grows into have to be
+// reachable via absolute branches. The host heap is not, so memalign is redirected (--wrap) to this pool.
+static uint8_t sModuleHeap[0x100000] __attribute__((aligned(0x20)));
+static uint32_t sModuleHeapUsed = 0;
+
+// The word OSGetUPID reads.
+static volatile uint32_t sUPID = 15;
+static uint64_t sTitleId       = 0x0005000010000000;
+static std::optional<uint16_t> sTitleVersion;
+
+static std::string_view StripRPLExtension(std::string_view rplName) {
+    if (rplName.ends_with(".rpx") || rplName.ends_with(".rpl")) {
+        rplName.remove_suffix(4);
+    }
+    return rplName;
+}
+
+static uint32_t GetTextSize(const HostModule &module) {
+    return module.functions.size() * HostSimulator::FUNCTION_SIZE;
+}
+
+static bool IsInImage(uint32_t effectiveAddress) {
+    return effectiveAddress >= (uint32_t) (uintptr_t) __executable_start && effectiveAddress < (uint32_t) (uintptr_t) _end;
+}
+
+static uint32_t *GetImageWord(uint32_t physicalAddress) {
+    auto effectiveAddress = physicalAddress - HostSimulator::IMAGE_PHYSICAL_OFFSET;
+    if (physicalAddress < HostSimulator::IMAGE_PHYSICAL_OFFSET || !IsInImage(effectiveAddress)) {
+        return nullptr;
+    }
+    return (uint32_t *) (uintptr_t) effectiveAddress;
+}
+
+static bool IsModulePhysicalAddress(uint32_t physicalAddress) {
+    return physicalAddress >= HostSimulator::MODULE_BASE + HostSimulator::MODULE_PHYSICAL_OFFSET && physicalAddress < sNextModuleAddress + HostSimulator::MODULE_PHYSICAL_OFFSET;
+}
+
+static HostModule *FindModule(std::string_view name) {
+    for (auto &cur : sModules) {
+        if (cur->name == name) {
+            return cur.get();
+        }
+    }
+    return nullptr;
+}
+
+extern "C" void *__wrap_memalign(size_t alignment, size_t size) {
+    auto offset = (sModuleHeapUsed + alignment - 1) & ~(alignment - 1);
+    if (offset + size > sizeof(sModuleHeap)) {
+        return nullptr;
+    }
+    // Only used for arenas, which are never freed.
+    sModuleHeapUsed = offset + size;
+    return &sModuleHeap[offset];
+}
+
+PlatformModule HostSimulator::loadModule(const char *name, std::span<const HostFunction> functions) {
+    auto module      = std::make_unique<HostModule>();
+    module->name     = name;
+    module->textAddr = sNextModuleAddress;
+    // Keep the names alive, the caller might pass temporaries.
+    module->functionNames.reserve(functions.size());
+    for (auto &cur : functions) {
+        module->functionNames.emplace_back(cur.name);
+        module->functions.push_back({module->functionNames.back().c_str(), cur.instruction});
+    }
+    sNextModuleAddress += (GetTextSize(*module) + 0xFFF) & ~0xFFF;
+
+    auto physicalAddress = module->textAddr + MODULE_PHYSICAL_OFFSET;
+    for (auto &cur : module->functions) {
+        sPhysicalMemory[physicalAddress]     = cur.instruction;
+        sPhysicalMemory[physicalAddress + 4] = PPCInstructions::BLR;
+        physicalAddress += FUNCTION_SIZE;
+    }
+    sModules.push_back(std::move(module));
+    return sModules.back().get();
+}
+
+void HostSimulator::unloadModule(PlatformModule handle) {
+    auto it = std::find_if(sModules.begin(), sModules.end(), [handle](auto &cur) { return cur.get() == handle; });
+    if (it == sModules.end()) {
+        OSFatal("HostSimulator: Tried to unload a module that is not loaded");
+    }
+    // The memory is reused by whatever gets loaded next.
+    auto physicalAddress = (*it)->textAddr + MODULE_PHYSICAL_OFFSET;
+    for (uint32_t i = 0; i < GetTextSize(**it); i += 4) {
+        sPhysicalMemory[physicalAddress + i] = 0;
+    }
+    sUnloadedModules.push_back(std::move(*it));
+    sModules.erase(it);
+}
+
+PlatformRPLInfo HostSimulator::getRPLInfo(PlatformModule handle) {
+    auto *module = (HostModule *) handle;
+    return {module->name.c_str(), module->textAddr, GetTextSize(*module)};
+}
+
+void HostSimulator::setProcess(uint32_t upid, uint64_t titleId, std::optional<uint16_t> titleVersion) {
+    sUPID         = upid;
+    sTitleId      = titleId;
+    sTitleVersion = titleVersion;
+}
+
+std::optional<uint32_t> HostSimulator::call(uint32_t effectiveAddress, uint32_t coreId, uint32_t counterAddress) {
+    std::vector<TrampolineInterpreter::Region> regions;
+    for (auto &module : sModules) {
+        for (uint32_t i = 0; i < module->functions.size(); i++) {
+            auto address = module->textAddr + i * FUNCTION_SIZE;
+            // Only the entry can be patched, everything after it is the original function.
+            regions.push_back({address, &sPhysicalMemory[address + MODULE_PHYSICAL_OFFSET], 1});
+        }
+    }
+    regions.push_back({(uint32_t) (uintptr_t) gJumpHeapData, (const uint32_t *) gJumpHeapData, JUMP_HEAP_DATA_SIZE / 4});
+    // The arenas the TrampolineHeap has grown into.
+    regions.push_back({(uint32_t) (uintptr_t) sModuleHeap, (const uint32_t *) sModuleHeap, sModuleHeapUsed / 4});
+
+    TrampolineInterpreter::Memory memory = {};
+    memory.upidAddress                   = Platform::getUPIDAddress();
+    memory.upid                          = sUPID;
+    memory.coreId                        = coreId;
+    memory.counterAddress                = counterAddress;
+    // The counter is in host memory, the interpreter works on a copy of its slots.
+    auto *slots = (CallCounter::Slot *) (uintptr_t) counterAddress;
+    for (uint32_t i = 0; slots && i < CallCounter::CORE_COUNT; i++) {
+        memory.counters[i] = slots[i].count;
+    }
+
+    auto result = TrampolineInterpreter::run(regions.data(), regions.size(), effectiveAddress, memory);
+    if (!result.valid) {
+        return {};
+    }
+    for (uint32_t i = 0; slots && i < CallCounter::CORE_COUNT; i++) {
+        slots[i].count = memory.counters[i];
+    }
+    return result.exitAddress;
+}
+
+uint32_t HostSimulator::getPhysicalWrites(uint32_t physicalAddress) {
+    auto it = sPhysicalWrites.find(physicalAddress);
+    return it != sPhysicalWrites.end() ? it->second : 0;
+}
+
+uint32_t Platform::effectiveToPhysical(uint32_t effectiveAddress) {
+    for (auto &cur : sModules) {
+        if (effectiveAddress >= cur->textAddr && effectiveAddress < cur->textAddr + GetTextSize(*cur)) {
+            return effectiveAddress + HostSimulator::MODULE_PHYSICAL_OFFSET;
+        }
+    }
+    if (IsInImage(effectiveAddress)) {
+        return effectiveAddress + HostSimulator::IMAGE_PHYSICAL_OFFSET;
+    }
+    return 0;
+}
+
+bool Platform::readPhysical(uint32_t physicalAddress, uint32_t *out) {
+    if (auto *word = GetImageWord(physicalAddress)) {
+        *out = *word;
+        return true;
+    }
+    if (!IsModulePhysicalAddress(physicalAddress)) {
+        return false;
+    }
+    auto it = sPhysicalMemory.find(physicalAddress);
+    *out    = it != sPhysicalMemory.end() ? it->second : 0;
+    return true;
+}
+
+bool Platform::writePhysical(uint32_t physicalAddress, uint32_t value) {
+    if (auto *word = GetImageWord(physicalAddress)) {
+        *word = value;
+    } else if (IsModulePhysicalAddress(physicalAddress)) {
+        sPhysicalMemory[physicalAddress] = value;
+    } else {
+        return false;
+    }
+    sPhysicalWrites[physicalAddress]++;
+    return true;
+}
+
+uint32_t Platform::readEffective(uint32_t effectiveAddress) {
+    uint32_t result      = 0;
+    auto physicalAddress = effectiveToPhysical(effectiveAddress);
+    if (!physicalAddress || !readPhysical(physicalAddress, &result)) {
+        OSFatal("HostSimulator: Tried to read unmapped memory");
+    }
+    return result;
+}
+
+void Platform::flushData(const void *, uint32_t) {
+}
+
+void Platform::invalidateInstructions(const void *, uint32_t) {
+}
+
+bool Platform::isModuleLoaded(const char *name, PlatformModule *outModule) {
+    auto *module = FindModule(name);
+    if (!module) {
+        return false;
+    }
+    *outModule = module;
+    return true;
+}
+
+uint32_t Platform::findFunctionExport(PlatformModule handle, const char *name) {
+    auto *module = (HostModule *) handle;
+    for (uint32_t i = 0; i < module->functions.size(); i++) {
+        if (std::string_view(module->functions[i].name) == name) {
+            return module->textAddr + i * HostSimulator::FUNCTION_SIZE;
+        }
+    }
+    return 0;
+}
+
+uint32_t Platform::getNumberOfRPLs() {
+    return sModules.size();
+}
+
+bool Platform::getRPLInfo(uint32_t first, uint32_t count, PlatformRPLInfo *outInfos) {
+    if (first + count > sModules.size()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        outInfos[i] = HostSimulator::getRPLInfo(sModules[first + i].get());
+    }
+    return true;
+}
+
+uint32_t Platform::findExecutableExport(std::string_view rplName, std::string_view functionName) {
+    for (auto &cur : sModules) {
+        if (StripRPLExtension(cur->name) == StripRPLExtension(rplName)) {
+            return findFunctionExport(cur.get(), std::string(functionName).c_str());
+        }
+    }
+    return 0;
+}
+
+void Platform::findExecutableExports(std::span<PlatformExportRequest> requests) {
+    for (auto &cur : requests) {
+        cur.address = findExecutableExport(cur.rplName, cur.functionName);
+    }
+}
+
+void Platform::resetExecutableExports(std::string_view) {
+}
+
+void Platform::resetAllExecutableExports() {
+}
+
+uint32_t Platform::getUPIDAddress() {
+    return (uint32_t) (uintptr_t) &sUPID;
+}
+
+uint32_t Platform::getUPID() {
+    return sUPID;
+}
+
+uint64_t Platform::getTitleId() {
+    return sTitleId;
+}
+
+std::optional<uint16_t> Platform::getTitleVersion(uint64_t) {
+    return sTitleVersion;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "utils/Platform.h"
+#include <cstdint>
+#include <optional>
+#include <span>
+
+typedef struct HostFunction {
+    const char *name;
+    uint32_t instruction; // first instruction, the function returns right after it
+} HostFunction;
+
+/**
+ * Simulated console behind the host implementation of Platform.
+ *
+ * Modules are loaded to a fake effective address (a new one for every load) and mapped to physical memory at
+ * MODULE_PHYSICAL_OFFSET. Their physical memory stays readable after an unload, but is cleared like it would be
+ * when it gets reused. The host image itself is mapped 1:1 to physical memory at IMAGE_PHYSICAL_OFFSET, so code
+ * in .data (e.g. the functions of the benchmark) can be patched as well.
+ *
+ * Code is never executed natively, call runs the function entries and the trampolines (the jump heap and the arenas
+ * it grows into) in the TrampolineInterpreter.
+ */
+class HostSimulator {
+public:
+    static constexpr uint32_t MODULE_BASE            = 0x10000000;
+    static constexpr uint32_t MODULE_PHYSICAL_OFFSET = 0x20000000;
+    static constexpr uint32_t IMAGE_PHYSICAL_OFFSET  = 0x60000000;
+    static constexpr uint32_t FUNCTION_SIZE          = 8;
+
+    /**
+     * Loads a module that exports the given functions, they are placed one after another in the given order.
+     * The module is not announced, call OnRPLLoaded with its getRPLInfo like the loader would.
+     */
+    static PlatformModule loadModule(const char *name, std::span<const HostFunction> functions);
+
+    static void unloadModule(PlatformModule module);
+
+    static PlatformRPLInfo getRPLInfo(PlatformModule module);
+
+    static void setProcess(uint32_t upid, uint64_t titleId, std::optional<uint16_t> titleVersion = {});
+
+    /**
+     * Calls the function at the given effective address in the current process on the given core.
+     * counterAddress is the CallCounter the trampolines are allowed to update, 0 if there is none.
+     * Returns the first address outside of the loaded functions and the trampolines, or an empty optional if
+     * the trampolines can't be interpreted.
+     */
+    static std::optional<uint32_t> call(uint32_t effectiveAddress, uint32_t coreId = 0, uint32_t counterAddress = 0);
+
+    /**
+     * Number of physical writes to the word at the given physical address.
+     */
+    static uint32_t getPhysicalWrites(uint32_t physicalAddress);
+};
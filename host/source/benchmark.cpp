@@ -0,0 +1,25 @@
+#include "Benchmark.h"
+#include "HostApplication.h"
+#include "HostSimulator.h"
+#include "utils/PPCInstructions.h"
+
+/*
+ * Runs the benchmark against the simulated console, the results are written to stdout.
+ * The timings are host timings, they are only comparable with other runs on the same machine.
+ */
+
+static const HostFunction sCoreinitFunctions[] = {
+        {"OSFunction", PPCInstructions::NOP},
+};
+
+int main() {
+    HostApplication::initialize();
+    // The benchmark only patches its own functions, but an application always has some RPLs loaded.
+    HostSimulator::loadModule("coreinit.rpl", sCoreinitFunctions);
+    HostApplication::start(15, 0x0005000010101010);
+
+    bool success = Benchmark::run();
+
+    HostApplication::end();
+    return success ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include <chrono>
+#include <coreinit/debug.h>
+#include <coreinit/time.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <whb/log.h>
+
+void OSReport(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void OSFatal(const char *msg) {
+    fprintf(stderr, "OSFatal: %s\n", msg);
+    abort();
+}
+
+OSTime OSGetTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void WHBLogPrintf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void WHBLogWritef(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
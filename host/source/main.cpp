@@ -0,0 +1,523 @@
+#include "HostApplication.h"
+#include "HostSimulator.h"
+#include "export.h"
+#include "function_patcher.h"
+#include "utils/PPCInstructions.h"
+#include "utils/globals.h"
+#include <algorithm>
+#include <coreinit/debug.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Runs the patcher against the simulated console and checks where calls of the patched functions end up.
+ * Exits with 1 if any check fails.
+ */
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            OSReport("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+            return false;                                                       \
+        }                                                                       \
+    } while (0)
+
+#define UPID_MENU        2
+#define UPID_HOME_MENU   5
+#define UPID_GAME        15
+
+#define GAME_TITLE_ID      0x0005000010101010
+#define GAME_TITLE_VERSION 32
+#define OTHER_TITLE_ID     0x0005000010202020
+#define MENU_TITLE_ID      0x0005001010040100
+
+// The replacements are never executed, calling them leaves the simulated code.
+#define REPLACEMENT_A    0x0F000000
+#define REPLACEMENT_GAME 0x0F000100
+#define REPLACEMENT_MENU 0x0F000200
+#define REPLACEMENT_HOME 0x0F000300
+#define REPLACEMENT_APP  0x0F000400
+// The replacements of the heap scenario are REPLACEMENT_MANY + 4 * i.
+#define REPLACEMENT_MANY 0x0E000000
+
+static const uint32_t ORIGINAL_A = PPCInstructions::addi(PPCInstructions::R3, PPCInstructions::R0, 1);
+static const uint32_t ORIGINAL_B = PPCInstructions::addi(PPCInstructions::R3, PPCInstructions::R0, 2);
+
+static const HostFunction sCoreinitFunctions[] = {
+        {"OSFunctionA", ORIGINAL_A},
+        {"OSFunctionB", ORIGINAL_B},
+};
+
+static const HostFunction sNsysnetFunctions[] = {
+        {"socket", PPCInstructions::NOP},
+};
+
+static const HostFunction sOtherFunctions[] = {
+        {"OtherFunction", PPCInstructions::NOP},
+};
+
+static const HostFunction sAppFunctions[] = {
+        {"AppMain", PPCInstructions::addi(PPCInstructions::R3, PPCInstructions::R0, 3)},
+        {"AppUpdate", PPCInstructions::addi(PPCInstructions::R3, PPCInstructions::R0, 4)},
+};
+
+static PlatformModule sCoreinit;
+static uint32_t sRealCalls[4];
+
+static function_replacement_data_t CreatePatch(const char *functionName, uint32_t replacement, uint32_t *realCall, FunctionPatcherTargetProcess targetProcess) {
+    function_replacement_data_t result = {};
+    result.version                     = FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION;
+    result.type                        = FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS;
+    result.replaceAddr                 = replacement;
+    result.replaceCall                 = realCall;
+    result.targetProcess               = targetProcess;
+    result.ReplaceInRPL.library        = LIBRARY_COREINIT;
+    result.ReplaceInRPL.function_name  = functionName;
+    return result;
+}
+
+static function_replacement_data_v4_t CreatePatchV4(const char *functionName, uint32_t replacement, uint32_t *realCall, FunctionPatcherTargetProcess targetProcess, uint32_t flags) {
+    auto v3                               = CreatePatch(functionName, replacement, realCall, targetProcess);
+    function_replacement_data_v4_t result = {};
+    // v4 only appends the flags.
+    memcpy(&result, &v3, sizeof(v3));
+    result.version = FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4;
+    result.flags   = flags;
+    return result;
+}
+
+static function_replacement_data_t CreateExecutablePatch(FunctionPatcherFunctionType type, const uint64_t *titleId, uint16_t versionMin, uint16_t versionMax, uint32_t *realCall) {
+    function_replacement_data_t result        = {};
+    result.version                            = FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION;
+    result.type                               = type;
+    result.replaceAddr                        = REPLACEMENT_APP;
+    result.replaceCall                        = realCall;
+    result.targetProcess                      = FP_TARGET_PROCESS_GAME;
+    result.ReplaceInRPX.targetTitleIds        = titleId;
+    result.ReplaceInRPX.targetTitleIdsCount   = 1;
+    result.ReplaceInRPX.versionMin            = versionMin;
+    result.ReplaceInRPX.versionMax            = versionMax;
+    result.ReplaceInRPX.executableName        = "app.rpx";
+    if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME) {
+        result.ReplaceInRPX.functionName = "AppMain";
+    } else {
+        result.ReplaceInRPX.textOffset = HostSimulator::FUNCTION_SIZE; // AppUpdate
+    }
+    return result;
+}
+
+/**
+ * Loads a module and announces it like the loader would.
+ */
+static PlatformModule LoadModule(const char *name, std::span<const HostFunction> functions) {
+    auto module = HostSimulator::loadModule(name, functions);
+    auto rpl    = HostSimulator::getRPLInfo(module);
+    OnRPLLoaded(&rpl);
+    return module;
+}
+
+static void UnloadModule(PlatformModule module) {
+    auto rpl = HostSimulator::getRPLInfo(module);
+    HostSimulator::unloadModule(module);
+    OnRPLUnloaded(module, &rpl);
+}
+
+static void SwitchApplication(uint32_t upid, uint64_t titleId) {
+    HostApplication::end();
+    HostApplication::start(upid, titleId, GAME_TITLE_VERSION);
+}
+
+static uint32_t GetFunction(const char *name) {
+    return Platform::findFunctionExport(sCoreinit, name);
+}
+
+static uint32_t ReadEntry(uint32_t effectiveAddress) {
+    uint32_t result = 0;
+    Platform::readPhysical(Platform::effectiveToPhysical(effectiveAddress), &result);
+    return result;
+}
+
+static std::optional<uint32_t> CallIn(uint32_t upid, uint32_t effectiveAddress) {
+    HostSimulator::setProcess(upid, GAME_TITLE_ID, GAME_TITLE_VERSION);
+    std::optional<uint32_t> result = HostSimulator::call(effectiveAddress);
+    // Every core has to see the same code.
+    for (uint32_t core = 1; core < 3; core++) {
+        if (HostSimulator::call(effectiveAddress, core) != result) {
+            return {};
+        }
+    }
+    HostSimulator::setProcess(UPID_GAME, GAME_TITLE_ID, GAME_TITLE_VERSION);
+    return result;
+}
+
+static bool IsPatched(PatchedFunctionHandle handle) {
+    bool result = false;
+    return FPIsFunctionPatched(handle, &result) == FUNCTION_PATCHER_RESULT_SUCCESS && result;
+}
+
+static bool TestAddRemove() {
+    auto function = GetFunction("OSFunctionA");
+    auto patch    = CreatePatch("OSFunctionA", REPLACEMENT_A, &sRealCalls[0], FP_TARGET_PROCESS_ALL);
+
+    PatchedFunctionHandle handle = 0;
+    bool hasBeenPatched          = false;
+    CHECK(FPAddFunctionPatch(&patch, &handle, &hasBeenPatched) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(hasBeenPatched && IsPatched(handle));
+    CHECK(HostSimulator::call(function) == REPLACEMENT_A);
+    // The real call executes the replaced instruction and continues after it.
+    CHECK(HostSimulator::call(sRealCalls[0]) == function + 4);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(ReadEntry(function) == ORIGINAL_A);
+    CHECK(HostSimulator::call(function) == function + 4);
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND);
+    return true;
+}
+
+static bool TestStack() {
+    auto function        = GetFunction("OSFunctionB");
+    auto physicalAddress = Platform::effectiveToPhysical(function);
+    auto game            = CreatePatch("OSFunctionB", REPLACEMENT_GAME, &sRealCalls[0], FP_TARGET_PROCESS_GAME);
+    auto menu            = CreatePatch("OSFunctionB", REPLACEMENT_MENU, &sRealCalls[1], FP_TARGET_PROCESS_WII_U_MENU);
+    auto home            = CreatePatch("OSFunctionB", REPLACEMENT_HOME, &sRealCalls[2], FP_TARGET_PROCESS_HOME_MENU);
+
+    PatchedFunctionHandle gameHandle = 0;
+    PatchedFunctionHandle menuHandle = 0;
+    PatchedFunctionHandle homeHandle = 0;
+    CHECK(FPAddFunctionPatch(&game, &gameHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPAddFunctionPatch(&menu, &menuHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(CallIn(UPID_GAME, function) == REPLACEMENT_GAME);
+    CHECK(CallIn(UPID_MENU, function) == REPLACEMENT_MENU);
+    CHECK(CallIn(UPID_HOME_MENU, function) == function + 4);
+    // The menu patch is stacked on the game patch, its real call passes through the game patch.
+    CHECK(CallIn(UPID_MENU, sRealCalls[1]) == function + 4);
+
+    // The patches are merged into a dispatcher now, another patch only changes its table.
+    CHECK(gProcessDispatchers.getEntryInstruction(physicalAddress).has_value());
+    auto writes = HostSimulator::getPhysicalWrites(physicalAddress);
+    CHECK(FPAddFunctionPatch(&home, &homeHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(HostSimulator::getPhysicalWrites(physicalAddress) == writes);
+    CHECK(CallIn(UPID_HOME_MENU, function) == REPLACEMENT_HOME);
+    CHECK(CallIn(UPID_GAME, function) == REPLACEMENT_GAME);
+
+    // Oldest first, the newer patches have to be relinked.
+    CHECK(FPRemoveFunctionPatch(gameHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(CallIn(UPID_GAME, function) == function + 4);
+    CHECK(CallIn(UPID_MENU, function) == REPLACEMENT_MENU);
+    CHECK(CallIn(UPID_HOME_MENU, function) == REPLACEMENT_HOME);
+    CHECK(CallIn(UPID_MENU, sRealCalls[1]) == function + 4);
+
+    CHECK(FPRemoveFunctionPatch(homeHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(!gProcessDispatchers.getEntryInstruction(physicalAddress).has_value());
+    CHECK(CallIn(UPID_HOME_MENU, function) == function + 4);
+    CHECK(CallIn(UPID_MENU, function) == REPLACEMENT_MENU);
+
+    CHECK(FPRemoveFunctionPatch(menuHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(ReadEntry(function) == ORIGINAL_B);
+    CHECK(CallIn(UPID_MENU, function) == function + 4);
+    return true;
+}
+
+static bool TestUnload() {
+    auto patch = CreatePatch("OSFunctionA", REPLACEMENT_A, &sRealCalls[0], FP_TARGET_PROCESS_ALL);
+
+    PatchedFunctionHandle handle = 0;
+    CHECK(FPAddFunctionPatch(&patch, &handle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(IsPatched(handle));
+
+    auto rpl = HostSimulator::getRPLInfo(sCoreinit);
+    HostSimulator::unloadModule(sCoreinit);
+    OnRPLUnloaded(sCoreinit, &rpl);
+    CHECK(!IsPatched(handle));
+
+    // The module is loaded to another address, the patch has to follow it.
+    sCoreinit = HostSimulator::loadModule("coreinit.rpl", sCoreinitFunctions);
+    rpl       = HostSimulator::getRPLInfo(sCoreinit);
+    OnRPLLoaded(&rpl);
+    auto function = GetFunction("OSFunctionA");
+    CHECK(IsPatched(handle));
+    CHECK(HostSimulator::call(function) == REPLACEMENT_A);
+    CHECK(HostSimulator::call(sRealCalls[0]) == function + 4);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(HostSimulator::call(function) == function + 4);
+    return true;
+}
+
+static bool TestAddPatches() {
+    auto functionA = GetFunction("OSFunctionA");
+    auto functionB = GetFunction("OSFunctionB");
+    auto a         = CreatePatch("OSFunctionA", REPLACEMENT_A, &sRealCalls[0], FP_TARGET_PROCESS_ALL);
+    auto invalid   = CreatePatch("OSFunctionA", REPLACEMENT_A, &sRealCalls[1], FP_TARGET_PROCESS_ALL);
+    auto b         = CreatePatch("OSFunctionB", REPLACEMENT_GAME, &sRealCalls[2], FP_TARGET_PROCESS_ALL);
+    invalid.version = 1;
+
+    function_replacement_data_t *patches[] = {&a, &invalid, &b};
+    PatchedFunctionHandle handles[3]       = {};
+    FunctionPatcherStatus statuses[3]      = {};
+    // The first error is returned, the valid patches are added anyway.
+    CHECK(FPAddFunctionPatches(patches, 3, handles, statuses) == FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION);
+    CHECK(statuses[0] == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(statuses[1] == FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION && handles[1] == 0);
+    CHECK(statuses[2] == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(IsPatched(handles[0]) && IsPatched(handles[2]));
+    CHECK(HostSimulator::call(functionA) == REPLACEMENT_A);
+    CHECK(HostSimulator::call(functionB) == REPLACEMENT_GAME);
+    CHECK(HostSimulator::call(sRealCalls[2]) == functionB + 4);
+
+    CHECK(FPRemoveFunctionPatch(handles[0]) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPRemoveFunctionPatch(handles[2]) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(HostSimulator::call(functionA) == functionA + 4);
+    CHECK(HostSimulator::call(functionB) == functionB + 4);
+    return true;
+}
+
+static bool TestPending() {
+    auto patch                 = CreatePatch("socket", REPLACEMENT_A, &sRealCalls[0], FP_TARGET_PROCESS_ALL);
+    patch.ReplaceInRPL.library = LIBRARY_NSYSNET;
+
+    PatchedFunctionHandle handle = 0;
+    bool hasBeenPatched          = true;
+    CHECK(FPAddFunctionPatch(&patch, &handle, &hasBeenPatched) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(!hasBeenPatched && !IsPatched(handle));
+
+    // Only the module the patch is waiting for retries it, a module whose name merely ends with it doesn't.
+    auto other   = LoadModule("other.rpl", sOtherFunctions);
+    auto similar = LoadModule("/vol/content/my_nsysnet.rpl", sOtherFunctions);
+    CHECK(!IsPatched(handle));
+    auto nsysnet  = LoadModule("nsysnet.rpl", sNsysnetFunctions);
+    auto function = Platform::findFunctionExport(nsysnet, "socket");
+    CHECK(IsPatched(handle));
+    CHECK(HostSimulator::call(function) == REPLACEMENT_A);
+    CHECK(HostSimulator::call(sRealCalls[0]) == function + 4);
+
+    // Tried when it was added and when nsysnet.rpl was loaded.
+    FunctionPatcherPatchStatistics statistics = {};
+    statistics.version                        = FUNCTION_PATCHER_STATISTICS_VERSION;
+    CHECK(FPGetFunctionPatchStatistics(handle, &statistics) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(statistics.patch.count == 2);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(HostSimulator::call(function) == function + 4);
+    UnloadModule(nsysnet);
+    UnloadModule(similar);
+    UnloadModule(other);
+    return true;
+}
+
+static bool TestExecutable() {
+    static const uint64_t gameTitleId = GAME_TITLE_ID;
+    auto app                          = LoadModule("app.rpx", sAppFunctions);
+    auto appMain                      = Platform::findFunctionExport(app, "AppMain");
+    auto appUpdate                    = Platform::findFunctionExport(app, "AppUpdate");
+
+    auto byName     = CreateExecutablePatch(FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME, &gameTitleId, 0, 0xFFFF, &sRealCalls[0]);
+    auto byAddress  = CreateExecutablePatch(FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS, &gameTitleId, 0, 0xFFFF, &sRealCalls[1]);
+    auto oldVersion = CreateExecutablePatch(FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME, &gameTitleId, 0, GAME_TITLE_VERSION - 1, &sRealCalls[2]);
+
+    PatchedFunctionHandle byNameHandle     = 0;
+    PatchedFunctionHandle byAddressHandle  = 0;
+    PatchedFunctionHandle oldVersionHandle = 0;
+    CHECK(FPAddFunctionPatch(&byName, &byNameHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPAddFunctionPatch(&byAddress, &byAddressHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPAddFunctionPatch(&oldVersion, &oldVersionHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(IsPatched(byNameHandle) && IsPatched(byAddressHandle));
+    CHECK(!IsPatched(oldVersionHandle));
+    CHECK(HostSimulator::call(appMain) == REPLACEMENT_APP);
+    CHECK(HostSimulator::call(sRealCalls[0]) == appMain + 4);
+    CHECK(HostSimulator::call(appUpdate) == REPLACEMENT_APP);
+    CHECK(HostSimulator::call(sRealCalls[1]) == appUpdate + 4);
+
+    CHECK(FPRemoveFunctionPatch(byNameHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPRemoveFunctionPatch(byAddressHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPRemoveFunctionPatch(oldVersionHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(ReadEntry(appMain) == sAppFunctions[0].instruction);
+    CHECK(ReadEntry(appUpdate) == sAppFunctions[1].instruction);
+    UnloadModule(app);
+    return true;
+}
+
+static bool TestTitleIndex() {
+    static const uint64_t otherTitleId = OTHER_TITLE_ID;
+    auto app                           = LoadModule("app.rpx", sAppFunctions);
+    auto patch                         = CreateExecutablePatch(FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME, &otherTitleId, 0, 0xFFFF, &sRealCalls[0]);
+
+    PatchedFunctionHandle handle = 0;
+    CHECK(FPAddFunctionPatch(&patch, &handle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(!IsPatched(handle));
+    auto isListed = [handle](uint64_t titleId) {
+        auto patches = gTitlePatches.getForTitle(titleId);
+        return std::ranges::any_of(patches, [handle](auto &cur) { return cur->getHandle() == handle; });
+    };
+    CHECK(!isListed(GAME_TITLE_ID));
+    CHECK(isListed(OTHER_TITLE_ID));
+
+    // The executable of the next title is loaded before it starts.
+    UnloadModule(app);
+    HostApplication::end();
+    app = LoadModule("app.rpx", sAppFunctions);
+    HostApplication::start(UPID_GAME, OTHER_TITLE_ID, GAME_TITLE_VERSION);
+    auto appMain = Platform::findFunctionExport(app, "AppMain");
+    CHECK(IsPatched(handle));
+    CHECK(HostSimulator::call(appMain) == REPLACEMENT_APP);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    UnloadModule(app);
+    SwitchApplication(UPID_GAME, GAME_TITLE_ID);
+    return true;
+}
+
+static bool TestCallCount() {
+    auto function = GetFunction("OSFunctionA");
+    auto counted  = CreatePatchV4("OSFunctionA", REPLACEMENT_A, &sRealCalls[0], FP_TARGET_PROCESS_ALL, FP_PATCH_FLAG_COUNT_CALLS);
+    auto plain    = CreatePatch("OSFunctionB", REPLACEMENT_GAME, &sRealCalls[1], FP_TARGET_PROCESS_ALL);
+
+    PatchedFunctionHandle countedHandle = 0;
+    PatchedFunctionHandle plainHandle   = 0;
+    CHECK(FPAddFunctionPatch((function_replacement_data_t *) &counted, &countedHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPAddFunctionPatch(&plain, &plainHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+
+    auto counterAddress = gPatchedFunctionHandles.get(countedHandle)->callCounter->getAddress();
+    for (uint32_t core = 0; core < 3; core++) {
+        CHECK(HostSimulator::call(function, core, counterAddress) == REPLACEMENT_A);
+    }
+    CHECK(HostSimulator::call(function, 1, counterAddress) == REPLACEMENT_A);
+    // Calling the original function isn't a call of the replacement.
+    CHECK(HostSimulator::call(sRealCalls[0], 0, counterAddress) == function + 4);
+
+    uint32_t callCount = 0;
+    CHECK(FPGetFunctionPatchCallCount(countedHandle, &callCount) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(callCount == 4);
+    CHECK(FPGetFunctionPatchCallCount(plainHandle, &callCount) == FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT);
+
+    CHECK(FPRemoveFunctionPatch(countedHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(FPRemoveFunctionPatch(plainHandle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    return true;
+}
+
+static bool TestSpecialise() {
+    auto function = GetFunction("OSFunctionB");
+    auto patch    = CreatePatchV4("OSFunctionB", REPLACEMENT_GAME, &sRealCalls[0], FP_TARGET_PROCESS_GAME, FP_PATCH_FLAG_SPECIALISE_PROCESS);
+
+    PatchedFunctionHandle handle = 0;
+    CHECK(FPAddFunctionPatch((function_replacement_data_t *) &patch, &handle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(IsPatched(handle));
+    // Decided once for the application, background processes get the replacement as well.
+    CHECK(CallIn(UPID_GAME, function) == REPLACEMENT_GAME);
+    CHECK(CallIn(UPID_HOME_MENU, function) == REPLACEMENT_GAME);
+    CHECK(!gProcessDispatchers.getEntryInstruction(Platform::effectiveToPhysical(function)).has_value());
+
+    // The patch must not survive into the Wii U Menu.
+    SwitchApplication(UPID_MENU, MENU_TITLE_ID);
+    CHECK(!IsPatched(handle));
+    CHECK(ReadEntry(function) == ORIGINAL_B);
+    CHECK(CallIn(UPID_MENU, function) == function + 4);
+
+    SwitchApplication(UPID_GAME, GAME_TITLE_ID);
+    CHECK(IsPatched(handle));
+    CHECK(CallIn(UPID_GAME, function) == REPLACEMENT_GAME);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(ReadEntry(function) == ORIGINAL_B);
+    return true;
+}
+
+static bool TestNoApplication() {
+    auto function = GetFunction("OSFunctionB");
+    auto patch    = CreatePatchV4("OSFunctionB", REPLACEMENT_GAME, &sRealCalls[0], FP_TARGET_PROCESS_GAME, FP_PATCH_FLAG_SPECIALISE_PROCESS);
+
+    // Between two applications the process is unknown, the patch waits for the next one.
+    HostApplication::end();
+    PatchedFunctionHandle handle = 0;
+    CHECK(FPAddFunctionPatch((function_replacement_data_t *) &patch, &handle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(!IsPatched(handle));
+    CHECK(ReadEntry(function) == ORIGINAL_B);
+
+    HostApplication::start(UPID_GAME, GAME_TITLE_ID, GAME_TITLE_VERSION);
+    CHECK(IsPatched(handle));
+    CHECK(CallIn(UPID_GAME, function) == REPLACEMENT_GAME);
+
+    CHECK(FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    return true;
+}
+
+static bool TestManyPatches() {
+    // Enough trampolines to outgrow the jump heap.
+    constexpr uint32_t count = 1500;
+    std::vector<std::string> names;
+    std::vector<HostFunction> functions;
+    names.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        names.push_back("GX2Function" + std::to_string(i));
+        functions.push_back({names.back().c_str(), PPCInstructions::NOP});
+    }
+    auto gx2 = LoadModule("gx2.rpl", functions);
+
+    std::vector<uint32_t> realCalls(count);
+    std::vector<function_replacement_data_t> patches;
+    std::vector<function_replacement_data_t *> patchPointers;
+    patches.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        patches.push_back(CreatePatch(names[i].c_str(), REPLACEMENT_MANY + i * 4, &realCalls[i], FP_TARGET_PROCESS_ALL));
+        patches.back().ReplaceInRPL.library = LIBRARY_GX2;
+        patchPointers.push_back(&patches.back());
+    }
+    std::vector<PatchedFunctionHandle> handles(count);
+    CHECK(FPAddFunctionPatches(patchPointers.data(), count, handles.data(), nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS);
+
+    FunctionPatcherJumpHeapStats stats = {};
+    stats.version                      = FUNCTION_PATCHER_JUMP_HEAP_STATS_VERSION;
+    CHECK(FPGetJumpHeapStats(&stats) == FUNCTION_PATCHER_RESULT_SUCCESS);
+    CHECK(stats.arenaCount > 1 && stats.failedAllocations == 0);
+
+    bool success = true;
+    for (uint32_t i = 0; i < count; i++) {
+        auto function = Platform::findFunctionExport(gx2, names[i].c_str());
+        success       = success && IsPatched(handles[i]);
+        success       = success && HostSimulator::call(function) == REPLACEMENT_MANY + i * 4;
+        success       = success && HostSimulator::call(realCalls[i]) == function + 4;
+    }
+    CHECK(success);
+
+    for (auto handle : handles) {
+        success = success && FPRemoveFunctionPatch(handle) == FUNCTION_PATCHER_RESULT_SUCCESS;
+    }
+    CHECK(success);
+    UnloadModule(gx2);
+    return true;
+}
+
+int main() {
+    HostApplication::initialize();
+    sCoreinit = HostSimulator::loadModule("coreinit.rpl", sCoreinitFunctions);
+    HostApplication::start(UPID_GAME, GAME_TITLE_ID, GAME_TITLE_VERSION);
+
+    typedef struct Scenario {
+        const char *name;
+        bool (*run)();
+    } Scenario;
+    const Scenario scenarios[] = {
+            {"add_remove", TestAddRemove},
+            {"stack", TestStack},
+            {"unload", TestUnload},
+            {"add_patches", TestAddPatches},
+            {"pending", TestPending},
+            {"executable", TestExecutable},
+            {"title_index", TestTitleIndex},
+            {"call_count", TestCallCount},
+            {"specialise", TestSpecialise},
+            {"no_application", TestNoApplication},
+            {"many_patches", TestManyPatches},
+    };
+
+    bool success = true;
+    for (auto &cur : scenarios) {
+        bool result = cur.run();
+        OSReport("%-14s %s\n", cur.name, result ? "ok" : "FAILED");
+        success = success && result;
+    }
+
+    HostApplication::end();
+    return success ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#ifdef BENCHMARK
+#include "Benchmark.h"
+#include "export.h"
+#include "function_patcher.h"
+#include "utils/PPCInstructions.h"
+#include "utils/Platform.h"
+#include "utils/globals.h"
+#include "utils/logger.h"
+
+#include <cinttypes>
+#include <coreinit/debug.h>
+#include <coreinit/time.h>
+#include <mutex>
+#include <vector>
+
+#define BENCHMARK_MAX_PATCHES      1000
+#define BENCHMARK_STORM_ITERATIONS ((uint32_t) 100)
+
+// Functions that are patched by the benchmark, each one is a single "blr".
+static uint32_t sTargetFunctions[BENCHMARK_MAX_PATCHES] __attribute__((section(".data"), aligned(0x20)));
+static uint32_t sRealCalls[BENCHMARK_MAX_PATCHES];
+static char sStormModuleName[] = "fp_benchmark.rpl";
+
+static uint32_t BenchmarkReplacement() {
+    return 0;
+}
+
+static uint32_t TicksToMicroseconds(OSTime ticks) {
+    return (uint32_t) OSTicksToMicroseconds(ticks);
+}
+
+static function_replacement_data_t CreatePatch(uint32_t functionIndex, uint32_t realCallIndex) {
+    auto address                       = (uint32_t) (uintptr_t) &sTargetFunctions[functionIndex];
+    function_replacement_data_t result = {};
+    result.version                     = FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION;
+    result.type                        = FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS;
+    result.physicalAddr                = Platform::effectiveToPhysical(address);
+    result.virtualAddr                 = address;
+    result.replaceAddr                 = (uint32_t) (uintptr_t) &BenchmarkReplacement;
+    result.replaceCall                 = &sRealCalls[realCallIndex];
+    result.targetProcess               = FP_TARGET_PROCESS_GAME_AND_MENU;
+    result.ReplaceInRPL.library        = LIBRARY_OTHER;
+    result.ReplaceInRPL.function_name  = nullptr;
+    return result;
+}
+
+static bool AddPatches(std::vector<function_replacement_data_t> &patches, std::vector<PatchedFunctionHandle> &outHandles, bool batch) {
+    outHandles.resize(patches.size());
+    if (batch) {
+        std::vector<function_replacement_data_t *> pointers;
+        pointers.reserve(patches.size());
+        for (auto &cur : patches) {
+            pointers.push_back(&cur);
+        }
+        return FPAddFunctionPatches(pointers.data(), pointers.size(), outHandles.data(), nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS;
+    }
+    for (uint32_t i = 0; i < patches.size(); i++) {
+        if (FPAddFunctionPatch(&patches[i], &outHandles[i], nullptr) != FUNCTION_PATCHER_RESULT_SUCCESS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RemovePatches(const std::vector<PatchedFunctionHandle> &handles, bool newestFirst) {
+    bool result = true;
+    for (uint32_t i = 0; i < handles.size(); i++) {
+        auto handle = newestFirst ? handles[handles.size() - 1 - i] : handles[i];
+        if (FPRemoveFunctionPatch(handle) != FUNCTION_PATCHER_RESULT_SUCCESS) {
+            result = false;
+        }
+    }
+    return result;
+}
+
+/**
+ * Adds and removes numPatches patches for different functions.
+ */
+static bool BenchmarkAddRemove(uint32_t numPatches, bool batch) {
+    std::vector<function_replacement_data_t> patches;
+    std::vector<PatchedFunctionHandle> handles;
+    patches.reserve(numPatches);
+    for (uint32_t i = 0; i < numPatches; i++) {
+        patches.push_back(CreatePatch(i, i));
+    }
+
+    auto start   = OSGetTime();
+    bool success = AddPatches(patches, handles, batch);
+    auto added   = OSGetTime();
+    success      = RemovePatches(handles, false) && success;
+    auto removed = OSGetTime();
+
+    OSReport("{\"benchmark\":\"add_remove\",\"mode\":\"%s\",\"patches\":%" PRIu32 ",\"addUs\":%" PRIu32 ",\"removeUs\":%" PRIu32 ",\"success\":%s}\n",
+             batch ? "batch" : "single", numPatches, TicksToMicroseconds(added - start), TicksToMicroseconds(removed - added), success ? "true" : "false");
+    return success;
+}
+
+/**
+ * Stacks depth patches on a single function and removes them again.
+ * Removing the oldest patch first always has to fix up the patch that has been stacked on top of it.
+ */
+static bool BenchmarkDeepStack(uint32_t depth, bool newestFirst) {
+    std::vector<function_replacement_data_t> patches;
+    std::vector<PatchedFunctionHandle> handles;
+    patches.reserve(depth);
+    for (uint32_t i = 0; i < depth; i++) {
+        patches.push_back(CreatePatch(0, i));
+    }
+
+    auto start   = OSGetTime();
+    bool success = AddPatches(patches, handles, false);
+    auto added   = OSGetTime();
+    success      = RemovePatches(handles, newestFirst) && success;
+    auto removed = OSGetTime();
+
+    OSReport("{\"benchmark\":\"deep_stack\",\"order\":\"%s\",\"depth\":%" PRIu32 ",\"addUs\":%" PRIu32 ",\"removeUs\":%" PRIu32 ",\"success\":%s}\n",
+             newestFirst ? "newest_first" : "oldest_first", depth, TicksToMicroseconds(added - start), TicksToMicroseconds(removed - added), success ? "true" : "false");
+    return success;
+}
+
+/**
+ * Simulates RPLs being loaded and unloaded while numPatches patches are applied.
+ * The unloaded range covers the patched functions, so every unload has to check all of them.
+ */
+static bool BenchmarkLoadUnloadStorm(uint32_t numPatches) {
+    std::vector<function_replacement_data_t> patches;
+    std::vector<PatchedFunctionHandle> handles;
+    patches.reserve(numPatches);
+    for (uint32_t i = 0; i < numPatches; i++) {
+        patches.push_back(CreatePatch(i, i));
+    }
+    bool success = AddPatches(patches, handles, true);
+
+    PlatformRPLInfo rpl = {sStormModuleName, (uint32_t) (uintptr_t) sTargetFunctions, sizeof(sTargetFunctions)};
+
+    OSTime notifyTicks = 0;
+    OSTime checkTicks  = 0;
+    for (uint32_t i = 0; i < BENCHMARK_STORM_ITERATIONS; i++) {
+        auto start = OSGetTime();
+        OnRPLLoaded(&rpl);
+        OnRPLUnloaded(nullptr, &rpl);
+        auto notified = OSGetTime();
+        {
+            std::lock_guard lock(gPatchedFunctionsMutex);
+            CheckIfPatchedFunctionsAreStillInMemory();
+        }
+        auto checked = OSGetTime();
+        notifyTicks += notified - start;
+        checkTicks += checked - notified;
+    }
+
+    // The code is never unloaded, so nothing must have been reset.
+    for (auto handle : handles) {
+        bool isPatched = false;
+        if (FPIsFunctionPatched(handle, &isPatched) != FUNCTION_PATCHER_RESULT_SUCCESS || !isPatched) {
+            success = false;
+        }
+    }
+    success = RemovePatches(handles, false) && success;
+
+    OSReport("{\"benchmark\":\"load_unload_storm\",\"patches\":%" PRIu32 ",\"iterations\":%" PRIu32 ",\"notifyUs\":%" PRIu32 ",\"checkUs\":%" PRIu32 ",\"success\":%s}\n",
+             numPatches, BENCHMARK_STORM_ITERATIONS, TicksToMicroseconds(notifyTicks), TicksToMicroseconds(checkTicks), success ? "true" : "false");
+    return success;
+}
+
+bool Benchmark::run() {
+    for (auto &cur : sTargetFunctions) {
+        cur = PPCInstructions::BLR;
+    }
+    Platform::flushCode(sTargetFunctions, sizeof(sTargetFunctions));
+
+    OSReport("{\"benchmark\":\"start\",\"version\":\"%s\"}\n", MODULE_VERSION_FULL);
+    bool success = true;
+    for (uint32_t numPatches : {1, 10, 100, 1000}) {
+        success = BenchmarkAddRemove(numPatches, false) && success;
+        success = BenchmarkAddRemove(numPatches, true) && success;
+    }
+    for (uint32_t depth : {10, 100}) {
+        success = BenchmarkDeepStack(depth, true) && success;
+        success = BenchmarkDeepStack(depth, false) && success;
+    }
+    for (uint32_t numPatches : {10, 100, 1000}) {
+        success = BenchmarkLoadUnloadStorm(numPatches) && success;
+    }
+
+    auto stats = gTrampolineHeap.getStats();
+    OSReport("{\"benchmark\":\"end\",\"heapBytesTotal\":%" PRIu32 ",\"heapBytesInUsePeak\":%" PRIu32 ",\"heapFailedAllocations\":%" PRIu32 "}\n",
+             stats.bytesTotal, stats.bytesInUsePeak, stats.failedAllocations);
+    return success;
+}
+#endif
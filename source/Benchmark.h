@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * Benchmark of the patch engine, only available when building with BENCHMARK=1 (or on the host, see host/).
+ *
+ * The patches target functions inside of this module, so the benchmark doesn't depend on any RPL and doesn't
+ * change the behaviour of the running application. Every result is written as a single JSON line via OSReport, e.g.
+ *   {"benchmark":"add_remove","mode":"batch","patches":100,"addUs":1234,"removeUs":2345}
+ */
+class Benchmark {
+public:
+    /**
+     * Returns false if any of the benchmarks failed.
+     */
+    static bool run();
+};
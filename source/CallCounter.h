@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Call counter of a patch with a separate cache line for each core.
+ *
+ * The trampoline selects the slot of the current core via UPIR (see Trampolines::writeCallCounterIncrement),
+ * so counting never causes traffic between the cores, even if the function is called on every core.
+ * The slots are summed up when the counter is read.
+ */
+class CallCounter {
+public:
+    static constexpr uint32_t CORE_COUNT = 3;
+    // log2 of the size of a slot, the size of a cache line.
+    static constexpr uint32_t SLOT_SHIFT = 5;
+    static constexpr uint32_t SLOT_SIZE  = 1 << SLOT_SHIFT;
+
+    typedef struct alignas(SLOT_SIZE) Slot {
+        volatile uint32_t count;
+    } Slot;
+
+    [[nodiscard]] uint32_t getAddress() const {
+        return (uint32_t) (uintptr_t) slots;
+    }
+
+    [[nodiscard]] uint32_t sum() const {
+        uint32_t result = 0;
+        for (auto &slot : slots) {
+            result += slot.count;
+        }
+        return result;
+    }
+
+private:
+    Slot slots[CORE_COUNT] = {};
+};
+
+static_assert(sizeof(CallCounter::Slot) == CallCounter::SLOT_SIZE);
+static_assert(sizeof(CallCounter) == CallCounter::CORE_COUNT * CallCounter::SLOT_SIZE);
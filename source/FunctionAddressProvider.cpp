@@ -1,41 +1,37 @@
 #include "FunctionAddressProvider.h"
+#include "utils/Platform.h"
 #include "utils/logger.h"
-#include <coreinit/dynload.h>
 #include <function_patcher/fpatching_defines.h>
 
 uint32_t FunctionAddressProvider::getEffectiveAddressOfFunction(function_replacement_library_type_t library, const char *functionName) {
-    uint32_t real_addr          = 0;
-    OSDynLoad_Module rpl_handle = nullptr;
-    OSDynLoad_Error err         = OS_DYNLOAD_OK;
+    if ((uint32_t) library >= LIBRARY_OTHER) {
+        DEBUG_FUNCTION_LINE_ERR("Failed to find the RPL handle for %s", functionName);
+        return 0;
+    }
 
-    for (auto &rplHandle : rpl_handles) {
-        if (rplHandle.library == library) {
-            if (rplHandle.handle == nullptr) {
-                DEBUG_FUNCTION_LINE_VERBOSE("Lets check if rpl is loaded: %s", rplHandle.rplname);
-                err = OSDynLoad_IsModuleLoaded((char *) rplHandle.rplname, &rplHandle.handle);
-            }
-            if (err != OS_DYNLOAD_OK || !rplHandle.handle) {
-                DEBUG_FUNCTION_LINE_VERBOSE("%s is not loaded yet. Err %d for handle %p", rplHandle.rplname, err, rplHandle.handle);
-                return 0;
-            }
-            rpl_handle = rplHandle.handle;
-            break;
+    auto &rpl = rpl_handles[library];
+    if (rpl.handle == nullptr) {
+        DEBUG_FUNCTION_LINE_VERBOSE("Lets check if rpl is loaded: %s", rpl_infos[library].rplname);
+        PlatformModule handle = nullptr;
+        if (!Platform::isModuleLoaded(rpl_infos[library].rplname, &handle)) {
+            DEBUG_FUNCTION_LINE_VERBOSE("%s is not loaded yet.", rpl_infos[library].rplname);
+            return 0;
         }
+        setHandle(library, handle);
     }
 
-    if (!rpl_handle) {
-        DEBUG_FUNCTION_LINE_ERR("Failed to find the RPL handle for %s", functionName);
-        return 0;
+    if (auto it = rpl.exportCache.find(functionName); it != rpl.exportCache.end()) {
+        return it->second;
     }
 
-    OSDynLoad_FindExport(rpl_handle, OS_DYNLOAD_EXPORT_FUNC, functionName, reinterpret_cast<void **>(&real_addr));
+    uint32_t real_addr = Platform::findFunctionExport(rpl.handle, functionName);
 
     if (!real_addr) {
         DEBUG_FUNCTION_LINE_VERBOSE("OSDynLoad_FindExport failed for %s", functionName);
         return 0;
     }
 
-    uint32_t realAddrData = *((volatile uint32_t *) real_addr);
+    uint32_t realAddrData = Platform::readEffective(real_addr);
 
     if ((realAddrData & 0xFC000003) == 0x48000000) {
         auto address_diff = (uint32_t) (realAddrData & 0x01FFFFFC);
@@ -45,34 +41,58 @@ uint32_t FunctionAddressProvider::getEffectiveAddressOfFunction(function_replace
         real_addr += (int32_t) address_diff;
     }
 
+    rpl.exportCache.emplace(functionName, real_addr);
+
     return real_addr;
 }
 
+void FunctionAddressProvider::setHandle(function_replacement_library_type_t library, PlatformModule handle) {
+    auto &rpl = rpl_handles[library];
+    if (rpl.handle != nullptr) {
+        rpl_handle_libraries.erase(rpl.handle);
+    }
+    rpl.handle = handle;
+    if (handle == nullptr) {
+        // The rpl has been unloaded.
+        rpl.exportCache.clear();
+        rpl.exportCacheTextAddress = 0;
+        return;
+    }
+    rpl_handle_libraries[handle] = library;
+
+    // The rpl might have been loaded to a different address, forget everything we resolved for the previous load.
+    auto textAddress = loadedRPLs ? loadedRPLs->findTextAddress(rpl_infos[library].rplname).value_or(0) : 0;
+    if (textAddress == 0 || textAddress != rpl.exportCacheTextAddress) {
+        rpl.exportCache.clear();
+    }
+    rpl.exportCacheTextAddress = textAddress;
+}
+
 void FunctionAddressProvider::resetHandles() {
-    for (auto &rplHandle : rpl_handles) {
-        if (rplHandle.handle != nullptr) {
-            DEBUG_FUNCTION_LINE_VERBOSE("Resetting handle for rpl: %s", rplHandle.rplname);
+    for (uint32_t i = 0; i < rpl_handles.size(); i++) {
+        if (rpl_handles[i].handle != nullptr) {
+            DEBUG_FUNCTION_LINE_VERBOSE("Resetting handle for rpl: %s", rpl_infos[i].rplname);
         }
 
-        rplHandle.handle = nullptr;
+        // The handles are only valid in the current process, the cached exports are checked against the text address once the handle is acquired again.
+        rpl_handles[i].handle = nullptr;
     }
+    rpl_handle_libraries.clear();
 }
 
-function_replacement_library_type_t FunctionAddressProvider::getTypeForHandle(OSDynLoad_Module handle) {
-    for (auto &rplHandle : rpl_handles) {
-        if (rplHandle.handle == handle) {
-            return rplHandle.library;
-        }
+function_replacement_library_type_t FunctionAddressProvider::getTypeForHandle(PlatformModule handle) {
+    auto it = rpl_handle_libraries.find(handle);
+    if (it == rpl_handle_libraries.end()) {
+        return LIBRARY_OTHER;
     }
-    return LIBRARY_OTHER;
+    return it->second;
 }
 
-bool FunctionAddressProvider::resetHandle(OSDynLoad_Module handle) {
-    for (auto &rplHandle : rpl_handles) {
-        if (rplHandle.handle == handle) {
-            rplHandle.handle = nullptr;
-            return true;
-        }
+bool FunctionAddressProvider::resetHandle(PlatformModule handle) {
+    auto it = rpl_handle_libraries.find(handle);
+    if (it == rpl_handle_libraries.end()) {
+        return false;
     }
-    return false;
+    setHandle(it->second, nullptr);
+    return true;
 }
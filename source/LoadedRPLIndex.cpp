@@ -0,0 +1,87 @@
+#include "LoadedRPLIndex.h"
+#include "utils/Platform.h"
+#include "utils/logger.h"
+#include <coreinit/debug.h>
+#include <vector>
+
+static std::string_view GetFileName(std::string_view name) {
+    auto pos = name.find_last_of("/\\");
+    if (pos != std::string_view::npos) {
+        name.remove_prefix(pos + 1);
+    }
+    return name;
+}
+
+bool LoadedRPLIndex::refresh() {
+    reset();
+
+    auto num_rpls = Platform::getNumberOfRPLs();
+    if (num_rpls == 0) {
+        DEBUG_FUNCTION_LINE_ERR("OSDynLoad_GetNumberOfRPLs failed. Missing patches?");
+        OSFatal("OSDynLoad_GetNumberOfRPLs failed. This shouldn't happen. Missing patches?");
+        return false;
+    }
+
+    std::vector<PlatformRPLInfo> rpls;
+    rpls.resize(num_rpls);
+
+    if (!Platform::getRPLInfo(0, num_rpls, rpls.data())) {
+        DEBUG_FUNCTION_LINE_ERR("OSDynLoad_GetRPLInfo failed. Missing patches?");
+        OSFatal("OSDynLoad_GetRPLInfo failed. This shouldn't happen. Missing patches?");
+        return false;
+    }
+
+    for (auto &rpl : rpls) {
+        add(rpl);
+    }
+    valid = true;
+    return true;
+}
+
+void LoadedRPLIndex::add(const PlatformRPLInfo &rpl) {
+    if (rpl.name == nullptr) {
+        return;
+    }
+    std::string_view name = rpl.name;
+    auto fileName         = GetFileName(name);
+    if (auto it = rplsByFileName.find(fileName); it != rplsByFileName.end()) {
+        // Keep the first one, just like a linear search over all RPLs would do. Reloads replace the old entry.
+        if (it->second.name == name) {
+            it->second.textAddr = rpl.textAddr;
+        }
+        return;
+    }
+    rplsByFileName.emplace(std::string(fileName), LoadedRPL{std::string(name), rpl.textAddr});
+}
+
+void LoadedRPLIndex::remove(std::string_view name) {
+    auto it = rplsByFileName.find(GetFileName(name));
+    if (it != rplsByFileName.end() && it->second.name == name) {
+        rplsByFileName.erase(it);
+    }
+}
+
+void LoadedRPLIndex::reset() {
+    valid = false;
+    rplsByFileName.clear();
+}
+
+std::optional<uint32_t> LoadedRPLIndex::findTextAddress(std::string_view nameSuffix) {
+    if (!valid && !refresh()) {
+        return {};
+    }
+
+    if (auto it = rplsByFileName.find(GetFileName(nameSuffix)); it != rplsByFileName.end()) {
+        if (std::string_view(it->second.name).ends_with(nameSuffix)) {
+            return it->second.textAddr;
+        }
+    }
+
+    // The suffix might only be a part of a file name.
+    for (auto &[fileName, rpl] : rplsByFileName) {
+        if (std::string_view(rpl.name).ends_with(nameSuffix)) {
+            return rpl.textAddr;
+        }
+    }
+    return {};
+}
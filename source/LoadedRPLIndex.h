@@ -0,0 +1,43 @@
+#pragma once
+
+#include "utils/Platform.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * Snapshot of the loaded RPLs/RPX indexed by their file name.
+ * The snapshot is taken once per application and then kept up to date via the load/unload notifications.
+ */
+class LoadedRPLIndex {
+public:
+    /**
+     * Replaces the snapshot with the currently loaded RPLs.
+     */
+    bool refresh();
+
+    void add(const PlatformRPLInfo &rpl);
+
+    void remove(std::string_view name);
+
+    /**
+     * Forgets the snapshot, the next lookup takes a new one.
+     */
+    void reset();
+
+    /**
+     * Returns the text address of the first loaded RPL whose name ends with nameSuffix.
+     */
+    std::optional<uint32_t> findTextAddress(std::string_view nameSuffix);
+
+private:
+    typedef struct LoadedRPL {
+        std::string name;
+        uint32_t textAddr;
+    } LoadedRPL;
+
+    bool valid = false;
+    std::map<std::string, LoadedRPL, std::less<>> rplsByFileName;
+};
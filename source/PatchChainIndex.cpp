@@ -0,0 +1,31 @@
+#include "PatchChainIndex.h"
+#include <algorithm>
+
+void PatchChainIndex::add(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    chains[patchedFunction->realPhysicalFunctionAddress].push_back(patchedFunction);
+}
+
+bool PatchChainIndex::remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    auto it = chains.find(patchedFunction->realPhysicalFunctionAddress);
+    if (it == chains.end()) {
+        return false;
+    }
+    auto &chain = it->second;
+    auto pos    = std::find(chain.begin(), chain.end(), patchedFunction);
+    if (pos == chain.end()) {
+        return false;
+    }
+    chain.erase(pos);
+    if (chain.empty()) {
+        chains.erase(it);
+    }
+    return true;
+}
+
+PatchChainIndex::Chain *PatchChainIndex::get(uint32_t physicalAddress) {
+    auto it = chains.find(physicalAddress);
+    if (it == chains.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
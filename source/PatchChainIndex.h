@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PatchedFunctionData.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Groups the currently applied patches by the physical address of the function they replace.
+ *
+ * The patches of a chain are ordered by the time they have been applied, the function entry jumps to the last patch.
+ * A PatchedFunctionData is part of a chain if and only if isPatched is set.
+ */
+class PatchChainIndex {
+public:
+    typedef std::vector<std::shared_ptr<PatchedFunctionData>> Chain;
+
+    void add(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    bool remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    Chain *get(uint32_t physicalAddress);
+
+    std::map<uint32_t, Chain> &getChains() {
+        return chains;
+    }
+
+private:
+    std::map<uint32_t, Chain> chains;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <coreinit/time.h>
+#include <cstdint>
+
+/**
+ * Time spent in the phases of patching and restoring functions, measured via OSGetTime.
+ * The phases are inclusive: NOTIFY_CALLBACK and RESTORE_FUNCTION contain the phases that run while they are measured.
+ *
+ * Like the other indices this is only accessed while gPatchedFunctionsMutex is locked.
+ */
+class PatchStatistics {
+public:
+    enum Phase : uint32_t {
+        SHOULD_BE_PATCHED,
+        UPDATE_FUNCTION_ADDRESSES,
+        READ_INSTRUCTION,
+        GENERATE_TRAMPOLINES,
+        WRITE_ON_ALL_CORES,
+        RESTORE_FUNCTION,
+        NOTIFY_CALLBACK,
+        CHECK_IF_STILL_IN_MEMORY,
+        PHASE_COUNT,
+    };
+
+    typedef struct Timing {
+        OSTime ticks   = 0;
+        uint32_t count = 0;
+
+        void add(OSTime duration) {
+            ticks += duration;
+            count++;
+        }
+    } Timing;
+
+    void add(Phase phase, OSTime duration) {
+        phases[phase].add(duration);
+    }
+
+    [[nodiscard]] const Timing &get(Phase phase) const {
+        return phases[phase];
+    }
+
+private:
+    std::array<Timing, PHASE_COUNT> phases = {};
+};
+
+/**
+ * Adds the time until the end of the scope to a phase.
+ */
+class ScopedPhaseTimer {
+public:
+    ScopedPhaseTimer(PatchStatistics &statistics, PatchStatistics::Phase phase) : statistics(statistics), phase(phase), start(OSGetTime()) {
+    }
+
+    ~ScopedPhaseTimer() {
+        statistics.add(phase, OSGetTime() - start);
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer &) = delete;
+
+    ScopedPhaseTimer &operator=(const ScopedPhaseTimer &) = delete;
+
+private:
+    PatchStatistics &statistics;
+    PatchStatistics::Phase phase;
+    OSTime start;
+};
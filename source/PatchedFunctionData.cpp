@@ -1,13 +1,16 @@
 #include "PatchedFunctionData.h"
-#include "utils/KernelFindExport.h"
+#include "utils/CurrentTitle.h"
+#include "utils/Platform.h"
+#include "utils/globals.h"
 #include "utils/utils.h"
-#include <coreinit/mcp.h>
-#include <coreinit/title.h>
+#include <cinttypes>
+#include <cstring>
 #include <vector>
 
 std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_shared_v3(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
                                                                                         function_replacement_data_v3_t *replacementData,
-                                                                                        MEMHeapHandle heapHandle) {
+                                                                                        TrampolineHeap *trampolineHeap,
+                                                                                        uint32_t flags) {
     if (!replacementData) {
         return {};
     }
@@ -19,16 +22,28 @@ std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_sh
     }
 
     ptr->isPatched                  = false;
-    ptr->heapHandle                 = heapHandle;
+    ptr->trampolineHeap             = trampolineHeap;
     ptr->replacementFunctionAddress = replacementData->replaceAddr;
     ptr->realCallFunctionAddressPtr = replacementData->replaceCall;
     ptr->targetProcess              = replacementData->targetProcess;
     ptr->type                       = replacementData->type;
 
+    if (flags & FP_PATCH_FLAG_COUNT_CALLS) {
+        ptr->callCounter = make_unique_nothrow<CallCounter>();
+        if (!ptr->callCounter) {
+            DEBUG_FUNCTION_LINE_ERR("Failed to alloc CallCounter");
+            return {};
+        }
+    }
+
+    ptr->specialiseProcess = (flags & FP_PATCH_FLAG_SPECIALISE_PROCESS) != 0;
+
     switch (replacementData->type) {
         case FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME:
         case FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS: {
-            ptr->library = {};
+            // An executable only exists in the process of the application.
+            ptr->specialiseProcess = true;
+            ptr->library           = {};
             for (uint32_t i = 0; i < replacementData->ReplaceInRPX.targetTitleIdsCount; i++) {
                 ptr->titleIds.insert(replacementData->ReplaceInRPX.targetTitleIds[i]);
             }
@@ -61,9 +76,19 @@ std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_sh
     return ptr;
 }
 
+std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_shared_v4(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
+                                                                                        function_replacement_data_v4_t *replacementData,
+                                                                                        TrampolineHeap *trampolineHeap) {
+    if (!replacementData) {
+        return {};
+    }
+    // v4 only appends the flags to the v3 layout.
+    return make_shared_v3(std::move(functionAddressProvider), (function_replacement_data_v3_t *) replacementData, trampolineHeap, replacementData->flags);
+}
+
 std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_shared_v2(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
                                                                                         function_replacement_data_v2_t *replacementData,
-                                                                                        MEMHeapHandle heapHandle) {
+                                                                                        TrampolineHeap *trampolineHeap) {
     if (!replacementData) {
         return {};
     }
@@ -75,7 +100,7 @@ std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_sh
 
     ptr->type                       = FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS;
     ptr->isPatched                  = false;
-    ptr->heapHandle                 = heapHandle;
+    ptr->trampolineHeap             = trampolineHeap;
     ptr->library                    = replacementData->library;
     ptr->targetProcess              = replacementData->targetProcess;
     ptr->replacementFunctionAddress = replacementData->replaceAddr;
@@ -96,30 +121,109 @@ std::optional<std::shared_ptr<PatchedFunctionData>> PatchedFunctionData::make_sh
 }
 
 
-bool PatchedFunctionData::allocateDataForJumps() {
-    if (this->jumpData != nullptr && this->jumpToOriginal != nullptr) {
-        return true;
+TrampolineParameters PatchedFunctionData::getTrampolineParameters() const {
+    TrampolineParameters params = {};
+    params.functionAddress      = this->realEffectiveFunctionAddress;
+    params.replacedInstruction  = this->replacedInstruction;
+    params.replacementAddress   = this->replacementFunctionAddress;
+    // A specialised patch is only applied in the targeted process.
+    params.targetProcess = isProcessSpecialised() ? FP_TARGET_PROCESS_ALL : this->targetProcess;
+    // Load the UPID the same way OSGetUPID does.
+    auto upidAddress       = Platform::getUPIDAddress();
+    params.upidAddressHigh = PPCInstructions::getAddressHigh(upidAddress);
+    params.upidAddressLow  = PPCInstructions::getAddressLow(upidAddress);
+
+    params.callCounterAddress = this->callCounter ? this->callCounter->getAddress() : 0;
+    return params;
+}
+
+bool PatchedFunctionData::needsJumpData() const {
+    return Trampolines::needsJumpData(getTrampolineParameters());
+}
+
+uint32_t PatchedFunctionData::buildJumpToOriginal(uint32_t *out, uint32_t address) const {
+    return Trampolines::buildJumpToOriginal(out, address, getTrampolineParameters());
+}
+
+uint32_t PatchedFunctionData::buildJumpData(uint32_t *out, uint32_t address) const {
+    return Trampolines::buildJumpData(out, address, getTrampolineParameters());
+}
+
+bool PatchedFunctionData::fitTrampoline(uint32_t *&trampoline, uint32_t &size, uint32_t &capacity, uint32_t nearAddress, TrampolineBuilder build) {
+    uint32_t buffer[Trampolines::MAX_SIZE];
+
+    // Keep the current memory if the trampoline still needs the same size class.
+    if (trampoline) {
+        auto newSize = (this->*build)(buffer, (uint32_t) (uintptr_t) trampoline);
+        if (TrampolineHeap::getSizeClassWords(newSize) == capacity) {
+            size = newSize;
+            return true;
+        }
     }
-    if (this->replacementFunctionAddress > 0x01FFFFFC || this->targetProcess != FP_TARGET_PROCESS_ALL) {
-        this->jumpDataSize = 15; // We could predict the actual size and save some memory, but at the moment we don't need it.
-        this->jumpData     = (uint32_t *) MEMAllocFromExpHeapEx(this->heapHandle, this->jumpDataSize * sizeof(uint32_t), 4);
 
-        if (!this->jumpData) {
-            DEBUG_FUNCTION_LINE_ERR("Failed to alloc jump data");
+    // Try to place the trampoline where its jumps only need a single instruction.
+    auto estimatedSize    = (this->*build)(buffer, nearAddress);
+    uint32_t *newLocation = this->trampolineHeap->alloc(estimatedSize, nearAddress);
+    uint32_t newSize      = 0;
+    uint32_t newCapacity  = TrampolineHeap::getSizeClassWords(estimatedSize);
+    if (newLocation) {
+        newSize = (this->*build)(buffer, (uint32_t) (uintptr_t) newLocation);
+        if (newSize > newCapacity) {
+            this->trampolineHeap->free(newLocation);
+            newLocation = nullptr;
+        }
+    }
+
+    if (!newLocation) {
+        // Without relative branches the size doesn't depend on the location.
+        auto worstCaseSize = (this->*build)(buffer, 0);
+        if (trampoline && worstCaseSize <= capacity) {
+            size = (this->*build)(buffer, (uint32_t) (uintptr_t) trampoline);
+            return true;
+        }
+        newLocation = this->trampolineHeap->alloc(worstCaseSize);
+        if (!newLocation) {
             return false;
         }
+        newSize     = (this->*build)(buffer, (uint32_t) (uintptr_t) newLocation);
+        newCapacity = TrampolineHeap::getSizeClassWords(worstCaseSize);
+    }
+
+    this->trampolineHeap->free(trampoline);
+    trampoline = newLocation;
+    size       = newSize;
+    capacity   = newCapacity;
+    return true;
+}
+
+bool PatchedFunctionData::allocateDataForJumps() {
+    if (this->jumpToOriginal != nullptr && (this->jumpData != nullptr || !needsJumpData())) {
+        return true;
     }
+    // The address of the function usually isn't known yet, so this reserves enough for long jumps. fitDataForJumps shrinks it later.
+    return fitDataForJumps();
+}
 
-    this->jumpToOriginal = (uint32_t *) MEMAllocFromExpHeapEx(this->heapHandle, 0x5 * sizeof(uint32_t), 4);
+bool PatchedFunctionData::fitDataForJumps() {
+    if (!needsJumpData()) {
+        this->trampolineHeap->free(this->jumpData);
+        this->jumpData         = nullptr;
+        this->jumpDataSize     = 0;
+        this->jumpDataCapacity = 0;
+    } else if (!fitTrampoline(this->jumpData, this->jumpDataSize, this->jumpDataCapacity, this->realEffectiveFunctionAddress, &PatchedFunctionData::buildJumpData)) {
+        DEBUG_FUNCTION_LINE_ERR("Failed to alloc jump data");
+        return false;
+    }
 
-    if (!this->jumpToOriginal) {
+    auto jumpToOriginalTarget = this->realEffectiveFunctionAddress ? this->realEffectiveFunctionAddress + 4 : 0;
+    if (!fitTrampoline(this->jumpToOriginal, this->jumpToOriginalSize, this->jumpToOriginalCapacity, jumpToOriginalTarget, &PatchedFunctionData::buildJumpToOriginal)) {
         DEBUG_FUNCTION_LINE_ERR("Failed to alloc jump data");
         return false;
     }
     return true;
 }
 
-bool PatchedFunctionData::getAddressForExecutable(uint32_t *outAddress) const {
+bool PatchedFunctionData::getAddressForExecutable(uint32_t *outAddress, std::optional<uint32_t> resolvedAddress) const {
     if (!outAddress) {
         return false;
     }
@@ -130,31 +234,9 @@ bool PatchedFunctionData::getAddressForExecutable(uint32_t *outAddress) const {
 
     uint32_t result = 0;
     if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS) {
-        int num_rpls = OSDynLoad_GetNumberOfRPLs();
-        if (num_rpls == 0) {
-            DEBUG_FUNCTION_LINE_ERR("OSDynLoad_GetNumberOfRPLs failed. Missing patches?");
-            OSFatal("OSDynLoad_GetNumberOfRPLs failed. This shouldn't happen. Missing patches?");
-            return false;
-        }
-
-        std::vector<OSDynLoad_NotifyData> rpls;
-        rpls.resize(num_rpls);
-
-        bool ret = OSDynLoad_GetRPLInfo(0, num_rpls, rpls.data());
-        if (!ret) {
-            DEBUG_FUNCTION_LINE_ERR("OSDynLoad_GetRPLInfo failed. Missing patches?");
-            OSFatal("OSDynLoad_GetNumberOfRPLs failed. This shouldn't happen. Missing patches?");
-            return false;
-        }
-        bool found = false;
-        for (auto &rpl : rpls) {
-            if (std::string_view(rpl.name).ends_with(executableName.value())) {
-                result = rpl.textAddr + textOffset;
-                found  = true;
-                break;
-            }
-        }
-        if (!found) {
+        // Uses a snapshot of the loaded RPLs that is kept up to date by the load/unload notifications.
+        auto textAddr = gLoadedRPLs.findTextAddress(executableName.value());
+        if (!textAddr) {
             if (executableName->ends_with(".rpx")) {
                 DEBUG_FUNCTION_LINE_ERR("Can't patch function. \"%s\" is not loaded.", executableName->c_str());
             } else {
@@ -162,13 +244,14 @@ bool PatchedFunctionData::getAddressForExecutable(uint32_t *outAddress) const {
             }
             return false;
         }
+        result = textAddr.value() + textOffset;
     } else if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME) {
         if (!this->functionName) {
             DEBUG_FUNCTION_LINE_ERR("Function name was empty. This should never happen.");
             OSFatal("Function name was empty. This should never happen. Check logs for more information.");
             return false;
         }
-        result = KernelFindExport(executableName.value(), functionName.value());
+        result = resolvedAddress ? resolvedAddress.value() : Platform::findExecutableExport(executableName.value(), functionName.value());
         if (result == 0) {
             DEBUG_FUNCTION_LINE_WARN("Failed to find function \"%s\" in \"%s\".", functionName->c_str(), executableName->c_str());
             return false;
@@ -183,10 +266,10 @@ bool PatchedFunctionData::getAddressForExecutable(uint32_t *outAddress) const {
     return true;
 }
 
-bool PatchedFunctionData::updateFunctionAddresses() {
+bool PatchedFunctionData::updateFunctionAddresses(std::optional<uint32_t> resolvedAddress) {
     uint32_t real_address;
     if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME || type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS) {
-        if (!getAddressForExecutable(&real_address)) {
+        if (!getAddressForExecutable(&real_address, resolvedAddress)) {
             return false;
         }
     } else {
@@ -214,7 +297,7 @@ bool PatchedFunctionData::updateFunctionAddresses() {
     }
 
     this->realEffectiveFunctionAddress = real_address;
-    auto physicalFunctionAddress       = (uint32_t) OSEffectiveToPhysical(real_address);
+    auto physicalFunctionAddress       = Platform::effectiveToPhysical(real_address);
     if (!physicalFunctionAddress) {
         DEBUG_FUNCTION_LINE_ERR("Error. Something is wrong with the physical address");
         OSFatal("Error. Something is wrong with the physical address");
@@ -230,134 +313,126 @@ void PatchedFunctionData::generateJumpToOriginal() {
         OSFatal("FunctionPatcherModule: this->jumpToOriginal is not allocated");
     }
 
-    uint32_t jumpToAddress = this->realEffectiveFunctionAddress + 4;
-
-    if (((uint32_t) jumpToAddress & 0x01FFFFFC) != (uint32_t) jumpToAddress) {
-        // We need to do a long jump
-        this->jumpToOriginal[0] = 0x3d600000 | ((jumpToAddress >> 16) & 0x0000FFFF); // lis        r11 ,0x1234
-        this->jumpToOriginal[1] = 0x616b0000 | (jumpToAddress & 0x0000ffff);         // ori        r11 ,r11 ,0x5678
-        this->jumpToOriginal[2] = 0x7d6903a6;                                        // mtspr      CTR ,r11
-        this->jumpToOriginal[3] = this->replacedInstruction;
-        this->jumpToOriginal[4] = 0x4e800420; // bctr
-    } else {
-        this->jumpToOriginal[0] = this->replacedInstruction;
-        this->jumpToOriginal[1] = 0x48000002 | (jumpToAddress & 0x01FFFFFC);
+    uint32_t buffer[Trampolines::MAX_SIZE];
+    auto size = buildJumpToOriginal(buffer, (uint32_t) (uintptr_t) this->jumpToOriginal);
+    if (size > this->jumpToOriginalCapacity) {
+        DEBUG_FUNCTION_LINE_ERR("Tried to overflow buffer. size: %08X vs array size: %08X", size, this->jumpToOriginalCapacity);
+        OSFatal("FunctionPatcherModule: Wrote too much data");
     }
+    memcpy(this->jumpToOriginal, buffer, size * sizeof(uint32_t));
+    this->jumpToOriginalSize = size;
 
-    DCFlushRange((void *) this->jumpToOriginal, sizeof(uint32_t) * 5);
-    ICInvalidateRange((void *) this->jumpToOriginal, sizeof(uint32_t) * 5);
+    Platform::flushCode(this->jumpToOriginal, sizeof(uint32_t) * this->jumpToOriginalSize);
 
-    *(this->realCallFunctionAddressPtr) = (uint32_t) this->jumpToOriginal;
+    *(this->realCallFunctionAddressPtr) = (uint32_t) (uintptr_t) this->jumpToOriginal;
     OSMemoryBarrier();
 }
 
 void PatchedFunctionData::generateReplacementJump() {
-    //setting jump back
-    this->replaceWithInstruction = 0x48000002 | (this->replacementFunctionAddress & 0x01FFFFFC);
-
-    // If the jump is too big, or we want only patch for certain processes we need a trampoline
-    if (this->replacementFunctionAddress > 0x01FFFFFC || this->targetProcess != FP_TARGET_PROCESS_ALL) {
+    if (needsJumpData()) {
         if (!this->jumpData) {
             DEBUG_FUNCTION_LINE_ERR("jumpData was not allocated");
             OSFatal("FunctionPatcherModule: jumpData was not allocated");
         }
-        uint32_t offset = 0;
-        if (this->targetProcess != FP_TARGET_PROCESS_ALL) {
-            auto originalFunctionAddrWithOffset = this->realEffectiveFunctionAddress + 4;
-            bool shortBranchToOriginalPossible  = ((uint32_t) originalFunctionAddrWithOffset & 0x01FFFFFC) == (uint32_t) originalFunctionAddrWithOffset;
-            // Only use patched function if OSGetUPID matches function_data->targetProcess
-            this->jumpData[offset++] = 0x3d600000 | (((uint32_t *) OSGetUPID)[0] & 0x0000FFFF); // lis        r11 ,0x0
-            this->jumpData[offset++] = 0x816b0000 | (((uint32_t *) OSGetUPID)[1] & 0x0000FFFF); // lwz        r11 ,0x0(r11)
-            if (this->targetProcess == FP_TARGET_PROCESS_GAME_AND_MENU) {
-                this->jumpData[offset++] = 0x2c0b0000 | FP_TARGET_PROCESS_WII_U_MENU;                              // cmpwi      r11 ,FP_TARGET_PROCESS_WII_U_MENU
-                this->jumpData[offset++] = 0x41820000 | (shortBranchToOriginalPossible ? 0x00000014 : 0x00000020); // beq        myfunc
-                this->jumpData[offset++] = 0x2c0b0000 | FP_TARGET_PROCESS_GAME;                                    // cmpwi      r11 ,FP_TARGET_PROCESS_GAME
-                this->jumpData[offset++] = 0x41820000 | (shortBranchToOriginalPossible ? 0x0000000C : 0x00000018); // beq        myfunc
-            } else {
-                this->jumpData[offset++] = 0x2c0b0000 | this->targetProcess;                                       // cmpwi      r11 ,function_data->targetProcess
-                this->jumpData[offset++] = 0x41820000 | (shortBranchToOriginalPossible ? 0x0000000C : 0x00000018); // beq        myfunc
-            }
-
-            this->jumpData[offset++] = this->replacedInstruction;
-            if (((uint32_t) originalFunctionAddrWithOffset & 0x01FFFFFC) != (uint32_t) originalFunctionAddrWithOffset) {
-                this->jumpData[offset++] = 0x3d600000 | (((this->realEffectiveFunctionAddress + 4) >> 16) & 0x0000FFFF); // lis        r11 ,(real_addr + 4)@hi
-                this->jumpData[offset++] = 0x616b0000 | ((this->realEffectiveFunctionAddress + 4) & 0x0000ffff);         // ori        r11 ,(real_addr + 4)@lo
-                this->jumpData[offset++] = 0x7d6903a6;                                                                   // mtspr      CTR ,r11
-                this->jumpData[offset++] = 0x4e800420;                                                                   // bctr
-            } else {
-                this->jumpData[offset++] = 0x48000002 | (originalFunctionAddrWithOffset & 0x01FFFFFC);
-            }
-        }
-        // myfunc:
-        if (((uint32_t) this->replacementFunctionAddress & 0x01FFFFFC) != (uint32_t) this->replacementFunctionAddress) {
-            this->jumpData[offset++] = 0x3d600000 | (((this->replacementFunctionAddress) >> 16) & 0x0000FFFF); // lis        r11 ,repl_addr@hi
-            this->jumpData[offset++] = 0x616b0000 | ((this->replacementFunctionAddress) & 0x0000ffff);         // ori        r11 ,r11 ,repl_addr@lo
-            this->jumpData[offset++] = 0x7d6903a6;                                                             // mtspr      CTR ,r11
-            this->jumpData[offset]   = 0x4e800420;                                                             // bctr
-        } else {
-            this->jumpData[offset] = 0x48000002 | (replacementFunctionAddress & 0x01FFFFFC);
-        }
 
-        if (offset >= this->jumpDataSize) {
-            DEBUG_FUNCTION_LINE_ERR("Tried to overflow buffer. offset: %08X vs array size: %08X", offset, this->jumpDataSize);
+        uint32_t buffer[Trampolines::MAX_SIZE];
+        auto size = buildJumpData(buffer, (uint32_t) (uintptr_t) this->jumpData);
+        if (size > this->jumpDataCapacity) {
+            DEBUG_FUNCTION_LINE_ERR("Tried to overflow buffer. size: %08X vs array size: %08X", size, this->jumpDataCapacity);
             OSFatal("FunctionPatcherModule: Wrote too much data");
         }
 
         // Make sure the trampoline itself is usable.
-        if (((uint32_t) this->jumpData & 0x01FFFFFC) != (uint32_t) this->jumpData) {
+        if (!PPCInstructions::isInAbsoluteBranchRange((uint32_t) (uintptr_t) this->jumpData)) {
             DEBUG_FUNCTION_LINE_ERR("Jump is impossible");
             OSFatal("FunctionPatcherModule: Jump is impossible");
         }
 
-        this->replaceWithInstruction = 0x48000002 | ((uint32_t) this->jumpData & 0x01FFFFFC);
+        memcpy(this->jumpData, buffer, size * sizeof(uint32_t));
+        this->jumpDataSize = size;
+
+        this->replaceWithInstruction = Trampolines::buildEntryInstruction(getTrampolineParameters(), (uint32_t) (uintptr_t) this->jumpData);
+
+        Platform::flushCode(this->jumpData, sizeof(uint32_t) * this->jumpDataSize);
+    } else {
+        this->replaceWithInstruction = Trampolines::buildEntryInstruction(getTrampolineParameters(), 0);
+    }
+
+    Platform::flushCode(&replaceWithInstruction, 4);
+
+    OSMemoryBarrier();
+}
+
+bool PatchedFunctionData::updateReplacedInstruction(uint32_t instruction) {
+    uint32_t jumpToOriginalBuffer[Trampolines::MAX_SIZE];
+    uint32_t jumpDataBuffer[Trampolines::MAX_SIZE];
+    auto oldInstruction       = this->replacedInstruction;
+    this->replacedInstruction = instruction;
 
-        DCFlushRange((void *) this->jumpData, sizeof(uint32_t) * 15);
-        ICInvalidateRange((void *) this->jumpData, sizeof(uint32_t) * 15);
+    // The trampolines are updated in place, this is only possible if their size doesn't change.
+    bool fits = true;
+    if (this->jumpToOriginal && buildJumpToOriginal(jumpToOriginalBuffer, (uint32_t) (uintptr_t) this->jumpToOriginal) != this->jumpToOriginalSize) {
+        fits = false;
+    }
+    if (this->jumpData && buildJumpData(jumpDataBuffer, (uint32_t) (uintptr_t) this->jumpData) != this->jumpDataSize) {
+        fits = false;
+    }
+    if (!fits) {
+        this->replacedInstruction = oldInstruction;
+        return false;
     }
 
-    DCFlushRange((void *) &replaceWithInstruction, 4);
-    ICInvalidateRange((void *) &replaceWithInstruction, 4);
+    // Only the instructions that depend on the replaced instruction actually change.
+    if (this->jumpToOriginal) {
+        memcpy(this->jumpToOriginal, jumpToOriginalBuffer, this->jumpToOriginalSize * sizeof(uint32_t));
+    }
+    if (this->jumpData) {
+        memcpy(this->jumpData, jumpDataBuffer, this->jumpDataSize * sizeof(uint32_t));
+    }
 
     OSMemoryBarrier();
+    return true;
 }
 
 PatchedFunctionData::~PatchedFunctionData() {
     if (this->jumpToOriginal) {
-        MEMFreeToExpHeap(this->heapHandle, this->jumpToOriginal);
+        this->trampolineHeap->free(this->jumpToOriginal);
         this->jumpToOriginal = nullptr;
     }
     if (this->jumpData) {
-        MEMFreeToExpHeap(this->heapHandle, this->jumpData);
+        this->trampolineHeap->free(this->jumpData);
         this->jumpData = nullptr;
     }
 }
 
 bool PatchedFunctionData::shouldBePatched() const {
-    if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME || type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS) {
-        uint64_t curTitleId = OSGetTitleID();
-        if (!this->titleIds.contains(curTitleId)) {
-            DEBUG_FUNCTION_LINE_VERBOSE("Skip function patch. Patch is not for title %016llX", curTitleId);
+    if (isProcessSpecialised()) {
+        // Without a running application there is no process to specialise for, it's patched once one starts.
+        auto processId = CurrentTitle::getProcessId();
+        if (!processId) {
+            DEBUG_FUNCTION_LINE_VERBOSE("Skip function patch. No application is running");
             return false;
         }
-        auto mcpHandle = MCP_Open();
-        MCPTitleListType titleInfo;
-        int32_t res = -1;
-        if ((curTitleId & 0x0000000F00000000) == 0) {
-            res = MCP_GetTitleInfo(mcpHandle, curTitleId | 0x0000000E00000000, &titleInfo);
+        if (!Trampolines::isTargetedProcess(targetProcess, processId.value())) {
+            DEBUG_FUNCTION_LINE_VERBOSE("Skip function patch. Patch is not for process %d", processId.value());
+            return false;
         }
-        if (res != 0) {
-            res = MCP_GetTitleInfo(mcpHandle, curTitleId, &titleInfo);
+    }
+    if (type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME || type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS) {
+        auto titleId = CurrentTitle::getTitleId();
+        if (!titleId || !this->titleIds.contains(titleId.value())) {
+            DEBUG_FUNCTION_LINE_VERBOSE("Skip function patch. Patch is not for the current title");
+            return false;
         }
-        MCP_Close(mcpHandle);
-        if (res != 0) {
-            DEBUG_FUNCTION_LINE_WARN("Failed to get title version of %016llX.", curTitleId);
+        auto titleVersion = CurrentTitle::getTitleVersion();
+        if (!titleVersion) {
+            DEBUG_FUNCTION_LINE_WARN("Failed to get title version of %016" PRIX64 ".", titleId.value());
             OSFatal("Failed to get title version. This should not happen.\n"
                     "Please report this with a crash log.");
             return false;
         }
-        MCP_Close(mcpHandle);
-        if (titleInfo.titleVersion < titleVersionMin || titleInfo.titleVersion > titleVersionMax) {
-            DEBUG_FUNCTION_LINE("Skipping function patch. Title version does not match: Expected  >= %d && <= %d. Real version: %d", titleVersionMin, titleVersionMax, titleInfo.titleVersion);
+        if (titleVersion.value() < titleVersionMin || titleVersion.value() > titleVersionMax) {
+            DEBUG_FUNCTION_LINE("Skipping function patch. Title version does not match: Expected  >= %d && <= %d. Real version: %d", titleVersionMin, titleVersionMax, titleVersion.value());
             return false;
         }
     }
@@ -1,13 +1,16 @@
 #pragma once
 
+#include "CallCounter.h"
 #include "FunctionAddressProvider.h"
+#include "PatchStatistics.h"
 #include "PatchedFunctionData.h"
+#include "TrampolineHeap.h"
+#include "Trampolines.h"
+#include "fpatching_defines_ext.h"
 #include "fpatching_defines_legacy.h"
 #include "utils/logger.h"
 #include <coreinit/cache.h>
 #include <coreinit/debug.h>
-#include <coreinit/memexpheap.h>
-#include <coreinit/memorymap.h>
 #include <cstdint>
 #include <function_patcher/fpatching_defines.h>
 #include <memory>
@@ -26,27 +29,65 @@ public:
 
     static std::optional<std::shared_ptr<PatchedFunctionData>> make_shared_v2(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
                                                                               function_replacement_data_v2_t *replacementData,
-                                                                              MEMHeapHandle heapHandle);
+                                                                              TrampolineHeap *trampolineHeap);
     static std::optional<std::shared_ptr<PatchedFunctionData>> make_shared_v3(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
                                                                               function_replacement_data_v3_t *replacementData,
-                                                                              MEMHeapHandle heapHandle);
+                                                                              TrampolineHeap *trampolineHeap,
+                                                                              uint32_t flags = FP_PATCH_FLAG_NONE);
+    static std::optional<std::shared_ptr<PatchedFunctionData>> make_shared_v4(std::shared_ptr<FunctionAddressProvider> functionAddressProvider,
+                                                                              function_replacement_data_v4_t *replacementData,
+                                                                              TrampolineHeap *trampolineHeap);
 
     bool allocateDataForJumps();
 
-    bool getAddressForExecutable(uint32_t *outAddress) const;
+    /**
+     * Shrinks (or grows) the trampolines to the exact size needed for the current function address.
+     * Must only be called while the function is not patched.
+     */
+    bool fitDataForJumps();
 
-    bool updateFunctionAddresses();
+    /**
+     * resolvedAddress is the address of a by-name executable patch if it has already been looked up (0 if it doesn't exist).
+     */
+    bool getAddressForExecutable(uint32_t *outAddress, std::optional<uint32_t> resolvedAddress = {}) const;
+
+    bool updateFunctionAddresses(std::optional<uint32_t> resolvedAddress = {});
 
     void generateJumpToOriginal();
 
     void generateReplacementJump();
 
+    /**
+     * Replaces the instruction this patch executes before jumping back to the original function.
+     * This is used to unlink a patch from a chain without restoring and re-applying the other patches.
+     * The caller has to flush the caches of the trampolines on all cores.
+     * Returns false (and changes nothing) if the trampolines would need a different size for the new instruction.
+     */
+    bool updateReplacedInstruction(uint32_t instruction);
+
     [[nodiscard]] bool shouldBePatched() const;
 
-    uint32_t getHandle() {
-        return (uint32_t) this;
+    /**
+     * True if the process is checked once per application instead of in the trampoline.
+     * The patch is then either applied without a process check or not applied at all.
+     */
+    [[nodiscard]] bool isProcessSpecialised() const {
+        return specialiseProcess && targetProcess != FP_TARGET_PROCESS_ALL;
+    }
+
+    /**
+     * Parameters the trampolines of this patch are built from.
+     */
+    [[nodiscard]] TrampolineParameters getTrampolineParameters() const;
+
+    [[nodiscard]] PatchedFunctionHandle getHandle() const {
+        return handle;
     }
 
+    PatchedFunctionHandle handle = {};
+    // Order in which the patches have been registered.
+    uint32_t registrationIndex = {};
+
     uint32_t *jumpToOriginal = {};
     uint32_t *jumpData       = {};
 
@@ -60,8 +101,19 @@ public:
     uint32_t replacedInstruction = {};
 
     uint32_t replaceWithInstruction = {};
-    uint32_t jumpDataSize           = 15;
-    MEMHeapHandle heapHandle        = nullptr;
+    // Size of the generated trampolines and of the memory allocated for them, in instructions.
+    uint32_t jumpDataSize           = 0;
+    uint32_t jumpDataCapacity       = 0;
+    uint32_t jumpToOriginalSize     = 0;
+    uint32_t jumpToOriginalCapacity = 0;
+    TrampolineHeap *trampolineHeap  = nullptr;
+    // Time spent on this patch, one measurement per attempt to patch (even if the target is not loaded yet) or restore it.
+    PatchStatistics::Timing patchTiming   = {};
+    PatchStatistics::Timing restoreTiming = {};
+
+    // Incremented by the trampoline every time the replacement is called, nullptr if the calls are not counted.
+    std::unique_ptr<CallCounter> callCounter = {};
+    bool specialiseProcess                   = false;
 
     FunctionPatcherFunctionType type = {};
     std::set<uint64_t> titleIds;
@@ -75,4 +127,16 @@ public:
     FunctionPatcherTargetProcess targetProcess                       = {};
     std::optional<std::string> functionName                          = {};
     std::shared_ptr<FunctionAddressProvider> functionAddressProvider = {};
+
+private:
+    // Writes a trampoline for the given address to out and returns its size.
+    typedef uint32_t (PatchedFunctionData::*TrampolineBuilder)(uint32_t *out, uint32_t address) const;
+
+    [[nodiscard]] bool needsJumpData() const;
+
+    uint32_t buildJumpToOriginal(uint32_t *out, uint32_t address) const;
+
+    uint32_t buildJumpData(uint32_t *out, uint32_t address) const;
+
+    bool fitTrampoline(uint32_t *&trampoline, uint32_t &size, uint32_t &capacity, uint32_t nearAddress, TrampolineBuilder build);
 };
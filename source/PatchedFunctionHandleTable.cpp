@@ -0,0 +1,59 @@
+#include "PatchedFunctionHandleTable.h"
+#include "utils/logger.h"
+
+#define HANDLE_INDEX(handle)                ((handle) &0xFFFF)
+#define HANDLE_GENERATION(handle)           ((handle) >> 16)
+#define MAKE_HANDLE(generation, index)      ((((uint32_t) (generation)) << 16) | (index))
+#define PATCHED_FUNCTION_HANDLE_TABLE_LIMIT 0xFFFF
+
+PatchedFunctionHandle PatchedFunctionHandleTable::add(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    uint16_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        if (slots.size() >= PATCHED_FUNCTION_HANDLE_TABLE_LIMIT) {
+            DEBUG_FUNCTION_LINE_ERR("Too many function patches");
+            return 0;
+        }
+        index = slots.size();
+        slots.emplace_back();
+    }
+    auto &slot           = slots[index];
+    slot.patchedFunction = patchedFunction;
+
+    auto handle                        = MAKE_HANDLE(slot.generation, index);
+    patchedFunction->handle            = handle;
+    patchedFunction->registrationIndex = nextRegistrationIndex++;
+    return handle;
+}
+
+std::shared_ptr<PatchedFunctionData> PatchedFunctionHandleTable::get(PatchedFunctionHandle handle) const {
+    auto index = HANDLE_INDEX(handle);
+    if (index >= slots.size()) {
+        return nullptr;
+    }
+    auto &slot = slots[index];
+    if (slot.generation != HANDLE_GENERATION(handle)) {
+        return nullptr;
+    }
+    return slot.patchedFunction;
+}
+
+bool PatchedFunctionHandleTable::remove(PatchedFunctionHandle handle) {
+    auto index = HANDLE_INDEX(handle);
+    if (index >= slots.size()) {
+        return false;
+    }
+    auto &slot = slots[index];
+    if (slot.generation != HANDLE_GENERATION(handle) || !slot.patchedFunction) {
+        return false;
+    }
+    slot.patchedFunction.reset();
+    // Handles are never 0, skip the generation 0 on overflow.
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    freeSlots.push_back(index);
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PatchedFunctionData.h"
+#include <cstdint>
+#include <function_patcher/fpatching_defines.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Maps PatchedFunctionHandles to PatchedFunctionData in constant time.
+ *
+ * A handle consists of a slot index (lower 16 bit) and the generation of the slot (upper 16 bit).
+ * The generation is increased every time a slot is freed, so a stale handle never resolves to a patch that reuses the slot.
+ * Adding a patch also sets its registrationIndex.
+ */
+class PatchedFunctionHandleTable {
+public:
+    PatchedFunctionHandle add(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    [[nodiscard]] std::shared_ptr<PatchedFunctionData> get(PatchedFunctionHandle handle) const;
+
+    bool remove(PatchedFunctionHandle handle);
+
+private:
+    typedef struct Slot {
+        uint16_t generation = 1;
+        std::shared_ptr<PatchedFunctionData> patchedFunction;
+    } Slot;
+
+    std::vector<Slot> slots;
+    std::vector<uint16_t> freeSlots;
+    uint32_t nextRegistrationIndex = 0;
+};
@@ -0,0 +1,106 @@
+#include "PendingPatchIndex.h"
+#include "FunctionAddressProvider.h"
+#include <algorithm>
+
+static std::string_view StripRPLExtension(std::string_view name) {
+    if (name.ends_with(".rpx") || name.ends_with(".rpl")) {
+        name.remove_suffix(4);
+    }
+    return name;
+}
+
+static bool ModuleNameMatches(std::string_view moduleName, std::string_view targetName) {
+    // Depending on the source the name may or may not contain a path or the file extension, but the file name has to match as a whole.
+    moduleName = StripRPLExtension(moduleName);
+    targetName = StripRPLExtension(targetName);
+    if (!moduleName.ends_with(targetName)) {
+        return false;
+    }
+    if (moduleName.size() == targetName.size()) {
+        return true;
+    }
+    auto separator = moduleName[moduleName.size() - targetName.size() - 1];
+    return separator == '/' || separator == '\\';
+}
+
+static void SortByRegistration(std::vector<std::shared_ptr<PatchedFunctionData>> &patchedFunctions) {
+    std::ranges::sort(patchedFunctions, [](auto &a, auto &b) { return a->registrationIndex < b->registrationIndex; });
+}
+
+PendingPatchIndex::Bucket *PendingPatchIndex::getBucket(const std::shared_ptr<PatchedFunctionData> &patchedFunction, bool create) {
+    if (patchedFunction->type == FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS) {
+        // Patches with a fixed address don't wait for anything.
+        if (!patchedFunction->library || patchedFunction->library == LIBRARY_OTHER) {
+            return nullptr;
+        }
+        auto it = libraryPatches.find(patchedFunction->library.value());
+        if (it != libraryPatches.end()) {
+            return &it->second;
+        }
+        return create ? &libraryPatches[patchedFunction->library.value()] : nullptr;
+    }
+
+    if (!patchedFunction->executableName) {
+        return nullptr;
+    }
+    auto it = executablePatches.find(patchedFunction->executableName.value());
+    if (it != executablePatches.end()) {
+        return &it->second;
+    }
+    return create ? &executablePatches[patchedFunction->executableName.value()] : nullptr;
+}
+
+void PendingPatchIndex::add(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    auto *bucket = getBucket(patchedFunction, true);
+    if (!bucket || std::ranges::find(*bucket, patchedFunction) != bucket->end()) {
+        return;
+    }
+    bucket->push_back(patchedFunction);
+}
+
+void PendingPatchIndex::remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    auto *bucket = getBucket(patchedFunction, false);
+    if (!bucket) {
+        return;
+    }
+    auto it = std::ranges::find(*bucket, patchedFunction);
+    if (it != bucket->end()) {
+        bucket->erase(it);
+    }
+}
+
+std::vector<std::shared_ptr<PatchedFunctionData>> PendingPatchIndex::takeForModule(std::string_view moduleName) {
+    std::vector<std::shared_ptr<PatchedFunctionData>> result;
+    for (auto it = libraryPatches.begin(); it != libraryPatches.end();) {
+        if (ModuleNameMatches(moduleName, FunctionAddressProvider::rpl_infos[it->first].rplname)) {
+            result.insert(result.end(), it->second.begin(), it->second.end());
+            it = libraryPatches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = executablePatches.begin(); it != executablePatches.end();) {
+        if (ModuleNameMatches(moduleName, it->first)) {
+            result.insert(result.end(), it->second.begin(), it->second.end());
+            it = executablePatches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    SortByRegistration(result);
+    return result;
+}
+
+std::vector<std::shared_ptr<PatchedFunctionData>> PendingPatchIndex::takeAll() {
+    std::vector<std::shared_ptr<PatchedFunctionData>> result;
+    for (auto &[library, bucket] : libraryPatches) {
+        result.insert(result.end(), bucket.begin(), bucket.end());
+    }
+    for (auto &[executableName, bucket] : executablePatches) {
+        result.insert(result.end(), bucket.begin(), bucket.end());
+    }
+    libraryPatches.clear();
+    executablePatches.clear();
+    SortByRegistration(result);
+    return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PatchedFunctionData.h"
+#include <function_patcher/fpatching_defines.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Keeps track of patches that could not be applied because the RPL/RPX they target is not loaded (yet),
+ * grouped by the library type or executable name they are waiting for.
+ */
+class PendingPatchIndex {
+public:
+    void add(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    void remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    /**
+     * Removes and returns all patches that are waiting for the module with the given name, ordered by registration.
+     */
+    std::vector<std::shared_ptr<PatchedFunctionData>> takeForModule(std::string_view moduleName);
+
+    /**
+     * Removes and returns all pending patches, ordered by registration.
+     */
+    std::vector<std::shared_ptr<PatchedFunctionData>> takeAll();
+
+private:
+    typedef std::vector<std::shared_ptr<PatchedFunctionData>> Bucket;
+
+    Bucket *getBucket(const std::shared_ptr<PatchedFunctionData> &patchedFunction, bool create);
+
+    std::map<function_replacement_library_type_t, Bucket> libraryPatches;
+    std::map<std::string, Bucket, std::less<>> executablePatches;
+};
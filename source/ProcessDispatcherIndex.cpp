@@ -0,0 +1,170 @@
+#include "ProcessDispatcherIndex.h"
+#include "Trampolines.h"
+#include "utils/Platform.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <coreinit/time.h>
+
+typedef struct EntryWrite {
+    uint32_t physicalAddress;
+    uint32_t effectiveAddress;
+    uint32_t instruction;
+    // Flushed before the entry is written, nullptr if the dispatcher is stopped.
+    const uint32_t *dispatcher;
+} EntryWrite;
+
+static void writeEntryAndFlushIC(void *arg) {
+    auto *write = (EntryWrite *) arg;
+    if (write->dispatcher) {
+        Platform::flushCode(write->dispatcher, Trampolines::DISPATCHER_SIZE * sizeof(uint32_t));
+    }
+    Platform::writePhysical(write->physicalAddress, write->instruction);
+    Platform::invalidateInstructions((void *) (uintptr_t) write->effectiveAddress, 4);
+}
+
+static void flushTable(void *arg) {
+    Platform::flushData(arg, Trampolines::DISPATCHER_TABLE_SIZE * sizeof(uint32_t));
+}
+
+std::vector<std::shared_ptr<PatchedFunctionData>> ProcessDispatcherIndex::findMergeablePatches(const PatchChainIndex::Chain &chain) {
+    std::vector<std::shared_ptr<PatchedFunctionData>> result;
+    uint32_t targetedUPIDs = 0;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        auto &cur = *it;
+        // Only patches that check the process in their jump data can be merged.
+        if (cur->targetProcess == FP_TARGET_PROCESS_ALL || cur->isProcessSpecialised() || !cur->jumpData || !cur->jumpToOriginal) {
+            break;
+        }
+        uint32_t upids = 0;
+        for (uint32_t upid = 0; upid < Trampolines::DISPATCHER_TABLE_SIZE; upid++) {
+            if (Trampolines::isTargetedProcess(cur->targetProcess, upid)) {
+                upids |= 1 << upid;
+            }
+        }
+        // An older patch that targets the same process is only called via the real call of a newer one.
+        if (upids & targetedUPIDs) {
+            break;
+        }
+        targetedUPIDs |= upids;
+        result.push_back(cur);
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+bool ProcessDispatcherIndex::buildTable(const std::vector<std::shared_ptr<PatchedFunctionData>> &patches, uint32_t *table) {
+    std::vector<TrampolineParameters> params;
+    std::vector<uint32_t> jumpDataAddresses;
+    params.reserve(patches.size());
+    jumpDataAddresses.reserve(patches.size());
+    for (auto &cur : patches) {
+        params.push_back(cur->getTrampolineParameters());
+        jumpDataAddresses.push_back((uint32_t) (uintptr_t) cur->jumpData);
+    }
+    // The processes no patch targets continue like the oldest patch does when it's not targeted.
+    return Trampolines::buildDispatcherTable(table, params.data(), jumpDataAddresses.data(), params.size(), (uint32_t) (uintptr_t) patches.front()->jumpToOriginal);
+}
+
+void ProcessDispatcherIndex::update(uint32_t physicalAddress, const PatchChainIndex::Chain *chain, uint32_t entryInstruction) {
+    auto it      = dispatchers.find(physicalAddress);
+    auto patches = chain ? findMergeablePatches(*chain) : std::vector<std::shared_ptr<PatchedFunctionData>>();
+
+    uint32_t table[Trampolines::DISPATCHER_TABLE_SIZE];
+    if (patches.size() < MIN_PATCHES || !buildTable(patches, table)) {
+        if (it != dispatchers.end()) {
+            stop(it, entryInstruction);
+        }
+        return;
+    }
+
+    if (it == dispatchers.end()) {
+        start(physicalAddress, std::move(patches), table);
+        return;
+    }
+    it->second.patches = std::move(patches);
+    writeTable(it->second, table);
+    DEBUG_FUNCTION_LINE_VERBOSE("Dispatcher %p of %08X merges %d patches", it->second.code, physicalAddress, it->second.patches.size());
+}
+
+void ProcessDispatcherIndex::start(uint32_t physicalAddress, std::vector<std::shared_ptr<PatchedFunctionData>> patches, const uint32_t *table) {
+    auto &newest         = patches.back();
+    auto *trampolineHeap = newest->trampolineHeap;
+    auto *code           = trampolineHeap->alloc(Trampolines::DISPATCHER_SIZE, 0);
+    if (!code) {
+        DEBUG_FUNCTION_LINE_WARN("Failed to alloc dispatcher, the patches of %08X stay unmerged", physicalAddress);
+        return;
+    }
+    if (!PPCInstructions::isInAbsoluteBranchRange((uint32_t) (uintptr_t) code)) {
+        DEBUG_FUNCTION_LINE_ERR("Dispatcher %p is not reachable via absolute branches", code);
+        trampolineHeap->free(code);
+        return;
+    }
+    Trampolines::buildDispatcher(code, (uint32_t) (uintptr_t) code, newest->getTrampolineParameters(), table);
+
+    auto &dispatcher = dispatchers[physicalAddress];
+    dispatcher       = {code, PPCInstructions::ba((uint32_t) (uintptr_t) code), newest->realEffectiveFunctionAddress, trampolineHeap, std::move(patches)};
+
+    EntryWrite write = {physicalAddress, dispatcher.effectiveAddress, dispatcher.entryInstruction, code};
+    runOnAllCores(writeEntryAndFlushIC, &write);
+
+    DEBUG_FUNCTION_LINE_VERBOSE("Merged %d patches of %08X into dispatcher %p", dispatcher.patches.size(), physicalAddress, code);
+}
+
+void ProcessDispatcherIndex::stop(std::map<uint32_t, Dispatcher>::iterator it, uint32_t entryInstruction) {
+    auto &dispatcher = it->second;
+    EntryWrite write = {it->first, dispatcher.effectiveAddress, entryInstruction, nullptr};
+    runOnAllCores(writeEntryAndFlushIC, &write);
+
+    DEBUG_FUNCTION_LINE_VERBOSE("Stopped dispatcher %p of %08X", dispatcher.code, it->first);
+    dispatcher.trampolineHeap->free(dispatcher.code);
+    dispatchers.erase(it);
+}
+
+void ProcessDispatcherIndex::writeTable(Dispatcher &dispatcher, const uint32_t *table) {
+    auto *current = (volatile uint32_t *) (dispatcher.code + Trampolines::DISPATCHER_CODE_SIZE);
+    bool changed  = false;
+    for (uint32_t i = 0; i < Trampolines::DISPATCHER_TABLE_SIZE; i++) {
+        if (current[i] != table[i]) {
+            current[i] = table[i];
+            changed    = true;
+        }
+    }
+    if (changed) {
+        runOnAllCores(flushTable, (void *) current);
+    }
+}
+
+void ProcessDispatcherIndex::park(uint32_t physicalAddress) {
+    auto it = dispatchers.find(physicalAddress);
+    if (it == dispatchers.end()) {
+        return;
+    }
+    uint32_t table[Trampolines::DISPATCHER_TABLE_SIZE];
+    std::fill(std::begin(table), std::end(table), (uint32_t) (uintptr_t) it->second.patches.back()->jumpData);
+    writeTable(it->second, table);
+}
+
+void ProcessDispatcherIndex::drop(uint32_t physicalAddress) {
+    auto it = dispatchers.find(physicalAddress);
+    if (it == dispatchers.end()) {
+        return;
+    }
+    it->second.trampolineHeap->free(it->second.code);
+    dispatchers.erase(it);
+}
+
+std::optional<uint32_t> ProcessDispatcherIndex::getEntryInstruction(uint32_t physicalAddress) const {
+    auto it = dispatchers.find(physicalAddress);
+    if (it == dispatchers.end()) {
+        return {};
+    }
+    return it->second.entryInstruction;
+}
+
+void ProcessDispatcherIndex::runOnAllCores(CoreWorkerPool::Callback callback, void *arg) {
+    auto start = OSGetTime();
+    CoreWorkerPool::runOnAllCores(callback, arg);
+    if (statistics) {
+        statistics->add(PatchStatistics::WRITE_ON_ALL_CORES, OSGetTime() - start);
+    }
+}
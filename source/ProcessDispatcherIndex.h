@@ -0,0 +1,86 @@
+#pragma once
+
+#include "PatchChainIndex.h"
+#include "PatchStatistics.h"
+#include "PatchedFunctionData.h"
+#include "TrampolineHeap.h"
+#include "utils/CoreWorkerPool.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * Merges the newest process filtered patches of a chain into a single dispatcher per function.
+ *
+ * If these patches target disjoint sets of processes, at most one of them is called in any process. The dispatcher loads
+ * the UPID once and jumps through a table to the targeted patch (or to the jump to original of the oldest merged patch),
+ * so a call costs the same no matter how many patches have been merged.
+ *
+ * The patches and their trampolines stay as they are, only the function entry is redirected. While a dispatcher is active
+ * it owns the function entry: the patches of the function must not write it, changes of the chain only rewrite single
+ * words of the table. The entry is only written when merging starts or stops.
+ */
+class ProcessDispatcherIndex {
+public:
+    // A single process filtered patch is cheaper than the dispatcher.
+    static constexpr uint32_t MIN_PATCHES = 2;
+
+    explicit ProcessDispatcherIndex(PatchStatistics *statistics) : statistics(statistics) {
+    }
+
+    /**
+     * Starts, updates or stops the dispatcher after the chain of the function has changed.
+     * entryInstruction is the instruction the function entry has without a dispatcher (the one of the newest patch,
+     * or the original instruction if the chain is empty). The trampolines of the chain have to be flushed on all cores.
+     */
+    void update(uint32_t physicalAddress, const PatchChainIndex::Chain *chain, uint32_t entryInstruction);
+
+    /**
+     * Lets the dispatcher jump to the newest merged patch for every process, it then behaves like the chain without it.
+     * Has to be called before the trampolines of a merged patch are changed, update() merges the patches again.
+     */
+    void park(uint32_t physicalAddress);
+
+    /**
+     * Frees the dispatcher without touching the function, e.g. because the function has been unloaded.
+     */
+    void drop(uint32_t physicalAddress);
+
+    /**
+     * Instruction at the function entry while a dispatcher is active.
+     */
+    [[nodiscard]] std::optional<uint32_t> getEntryInstruction(uint32_t physicalAddress) const;
+
+private:
+    typedef struct Dispatcher {
+        uint32_t *code;
+        uint32_t entryInstruction;
+        uint32_t effectiveAddress;
+        TrampolineHeap *trampolineHeap;
+        // Oldest patch first.
+        std::vector<std::shared_ptr<PatchedFunctionData>> patches;
+    } Dispatcher;
+
+    /**
+     * Newest patches of the chain that can be merged, oldest first.
+     */
+    static std::vector<std::shared_ptr<PatchedFunctionData>> findMergeablePatches(const PatchChainIndex::Chain &chain);
+
+    static bool buildTable(const std::vector<std::shared_ptr<PatchedFunctionData>> &patches, uint32_t *table);
+
+    void start(uint32_t physicalAddress, std::vector<std::shared_ptr<PatchedFunctionData>> patches, const uint32_t *table);
+
+    void stop(std::map<uint32_t, Dispatcher>::iterator it, uint32_t entryInstruction);
+
+    /**
+     * Writes the changed words of the table, a running dispatcher either reads the old or the new target.
+     */
+    void writeTable(Dispatcher &dispatcher, const uint32_t *table);
+
+    void runOnAllCores(CoreWorkerPool::Callback callback, void *arg);
+
+    PatchStatistics *statistics = nullptr;
+    std::map<uint32_t, Dispatcher> dispatchers;
+};
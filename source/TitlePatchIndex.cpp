@@ -0,0 +1,50 @@
+#include "TitlePatchIndex.h"
+#include <algorithm>
+#include <iterator>
+
+bool TitlePatchIndex::isTitleSpecific(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    return patchedFunction->type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME || patchedFunction->type == FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_ADDRESS;
+}
+
+void TitlePatchIndex::add(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (!isTitleSpecific(patchedFunction)) {
+        globalPatches.push_back(patchedFunction);
+        return;
+    }
+    for (auto titleId : patchedFunction->titleIds) {
+        titlePatches[titleId].push_back(patchedFunction);
+    }
+}
+
+void TitlePatchIndex::remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (!isTitleSpecific(patchedFunction)) {
+        if (auto it = std::ranges::find(globalPatches, patchedFunction); it != globalPatches.end()) {
+            globalPatches.erase(it);
+        }
+        return;
+    }
+    for (auto titleId : patchedFunction->titleIds) {
+        auto bucketIt = titlePatches.find(titleId);
+        if (bucketIt == titlePatches.end()) {
+            continue;
+        }
+        auto &bucket = bucketIt->second;
+        if (auto it = std::ranges::find(bucket, patchedFunction); it != bucket.end()) {
+            bucket.erase(it);
+        }
+        if (bucket.empty()) {
+            titlePatches.erase(bucketIt);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<PatchedFunctionData>> TitlePatchIndex::getForTitle(uint64_t titleId) const {
+    auto it = titlePatches.find(titleId);
+    if (it == titlePatches.end()) {
+        return globalPatches;
+    }
+    std::vector<std::shared_ptr<PatchedFunctionData>> result;
+    result.reserve(globalPatches.size() + it->second.size());
+    std::ranges::merge(globalPatches, it->second, std::back_inserter(result), [](auto &a, auto &b) { return a->registrationIndex < b->registrationIndex; });
+    return result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PatchedFunctionData.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Groups all registered patches by the title they are meant for.
+ * Patches of executables are listed for each of their title IDs, all other patches are global.
+ */
+class TitlePatchIndex {
+public:
+    void add(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    void remove(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    /**
+     * Returns the global patches and the patches for the given title, ordered by registration.
+     */
+    [[nodiscard]] std::vector<std::shared_ptr<PatchedFunctionData>> getForTitle(uint64_t titleId) const;
+
+private:
+    typedef std::vector<std::shared_ptr<PatchedFunctionData>> Bucket;
+
+    static bool isTitleSpecific(const std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+    // Buckets are ordered by registration because patches are only ever appended.
+    Bucket globalPatches;
+    std::unordered_map<uint64_t, Bucket> titlePatches;
+};
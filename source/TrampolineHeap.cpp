@@ -0,0 +1,213 @@
+#include "TrampolineHeap.h"
+#include "utils/logger.h"
+#include <malloc.h>
+
+bool TrampolineHeap::addArena(void *start, uint32_t size) {
+    std::lock_guard lock(mutex);
+    return addArenaLocked(start, size);
+}
+
+bool TrampolineHeap::addArenaLocked(void *start, uint32_t size) {
+    // Pages have to be 4 byte aligned.
+    auto alignedStart = (uint8_t *) (((uintptr_t) start + 3) & ~3);
+    size -= alignedStart - (uint8_t *) start;
+    auto numPages = size / PAGE_SIZE;
+    if (numPages == 0) {
+        return false;
+    }
+    // The trampolines are the target of "ba" instructions.
+    if ((uintptr_t) alignedStart + numPages * PAGE_SIZE > 0x02000000) {
+        DEBUG_FUNCTION_LINE_ERR("Arena %p is not reachable via absolute branches", alignedStart);
+        return false;
+    }
+
+    arenas.push_back({alignedStart, alignedStart + numPages * PAGE_SIZE, (uint32_t) pages.size()});
+    pages.reserve(pages.size() + numPages);
+    emptyPages.reserve(emptyPages.size() + numPages);
+    // Hand out the pages from the start of the arena first.
+    for (uint32_t i = numPages; i > 0; i--) {
+        emptyPages.push_back(pages.size() + i - 1);
+    }
+    for (uint32_t i = 0; i < numPages; i++) {
+        pages.push_back({alignedStart + i * PAGE_SIZE, 0, 0, 0, nullptr, NO_PAGE, NO_PAGE});
+    }
+    stats.arenaCount++;
+    stats.bytesTotal += numPages * PAGE_SIZE;
+    return true;
+}
+
+bool TrampolineHeap::growLocked() {
+    auto arena = memalign(0x20, GROW_ARENA_SIZE);
+    if (!arena) {
+        DEBUG_FUNCTION_LINE_ERR("Failed to allocate another arena for trampolines");
+        return false;
+    }
+    if (!addArenaLocked(arena, GROW_ARENA_SIZE)) {
+        ::free(arena);
+        return false;
+    }
+    DEBUG_FUNCTION_LINE_VERBOSE("Added trampoline arena %p. Total size: %d bytes", arena, stats.bytesTotal);
+    return true;
+}
+
+void TrampolineHeap::linkPartial(uint32_t pageIndex) {
+    auto &page       = pages[pageIndex];
+    auto &head       = partialPages[page.sizeClass];
+    page.prevPartial = NO_PAGE;
+    page.nextPartial = head;
+    if (head != NO_PAGE) {
+        pages[head].prevPartial = pageIndex;
+    }
+    head = pageIndex;
+}
+
+void TrampolineHeap::unlinkPartial(uint32_t pageIndex) {
+    auto &page = pages[pageIndex];
+    if (page.prevPartial != NO_PAGE) {
+        pages[page.prevPartial].nextPartial = page.nextPartial;
+    } else {
+        partialPages[page.sizeClass] = page.nextPartial;
+    }
+    if (page.nextPartial != NO_PAGE) {
+        pages[page.nextPartial].prevPartial = page.prevPartial;
+    }
+    page.prevPartial = NO_PAGE;
+    page.nextPartial = NO_PAGE;
+}
+
+bool TrampolineHeap::isPageNear(const Page &page, uint32_t address) {
+    // Every slot of the page has to be in range of a relative branch.
+    auto distanceStart = (int32_t) ((uint32_t) (uintptr_t) page.start - address);
+    auto distanceEnd   = (int32_t) ((uint32_t) (uintptr_t) page.start + PAGE_SIZE - address);
+    return distanceStart >= -0x02000000 && distanceStart < 0x02000000 && distanceEnd >= -0x02000000 && distanceEnd < 0x02000000;
+}
+
+uint32_t TrampolineHeap::findPartialPageLocked(uint32_t sizeClass, uint32_t nearAddress) {
+    if (nearAddress != 0) {
+        for (auto cur = partialPages[sizeClass]; cur != NO_PAGE; cur = pages[cur].nextPartial) {
+            if (isPageNear(pages[cur], nearAddress)) {
+                return cur;
+            }
+        }
+        // Rather start a new page near the address than using a page that is far away.
+        for (auto cur : emptyPages) {
+            if (isPageNear(pages[cur], nearAddress)) {
+                return NO_PAGE;
+            }
+        }
+    }
+    return partialPages[sizeClass];
+}
+
+uint32_t TrampolineHeap::takeEmptyPageLocked(uint32_t nearAddress) {
+    if (emptyPages.empty() && !growLocked()) {
+        return NO_PAGE;
+    }
+    auto it = emptyPages.end() - 1;
+    if (nearAddress != 0) {
+        for (auto cur = emptyPages.rbegin(); cur != emptyPages.rend(); ++cur) {
+            if (isPageNear(pages[*cur], nearAddress)) {
+                it = cur.base() - 1;
+                break;
+            }
+        }
+    }
+    auto result = *it;
+    *it         = emptyPages.back();
+    emptyPages.pop_back();
+    return result;
+}
+
+uint32_t *TrampolineHeap::alloc(uint32_t numWords, uint32_t nearAddress) {
+    uint32_t sizeClass = 0;
+    while (sizeClass < SIZE_CLASSES.size() && SIZE_CLASSES[sizeClass] < numWords) {
+        sizeClass++;
+    }
+    if (sizeClass == SIZE_CLASSES.size()) {
+        DEBUG_FUNCTION_LINE_ERR("Unsupported trampoline size: %d instructions", numWords);
+        return nullptr;
+    }
+
+    std::lock_guard lock(mutex);
+    auto pageIndex = findPartialPageLocked(sizeClass, nearAddress);
+    if (pageIndex == NO_PAGE) {
+        pageIndex = takeEmptyPageLocked(nearAddress);
+        if (pageIndex == NO_PAGE) {
+            stats.failedAllocations++;
+            return nullptr;
+        }
+
+        auto &page       = pages[pageIndex];
+        page.sizeClass   = sizeClass;
+        page.usedSlots   = 0;
+        page.carvedSlots = 0;
+        page.freeSlots   = nullptr;
+        linkPartial(pageIndex);
+    }
+
+    auto &page = pages[pageIndex];
+    uint32_t *result;
+    if (page.freeSlots) {
+        result         = page.freeSlots;
+        page.freeSlots = (uint32_t *) (uintptr_t) *result;
+    } else {
+        result = (uint32_t *) (page.start + page.carvedSlots * SIZE_CLASSES[sizeClass] * sizeof(uint32_t));
+        page.carvedSlots++;
+    }
+    page.usedSlots++;
+
+    stats.bytesInUse += SIZE_CLASSES[sizeClass] * sizeof(uint32_t);
+    if (stats.bytesInUse > stats.bytesInUsePeak) {
+        stats.bytesInUsePeak = stats.bytesInUse;
+    }
+
+    if (page.freeSlots == nullptr && page.carvedSlots == getSlotsPerPage(sizeClass)) {
+        // Page is full.
+        unlinkPartial(pageIndex);
+    }
+    return result;
+}
+
+uint32_t TrampolineHeap::findPage(const uint32_t *ptr) const {
+    for (auto &arena : arenas) {
+        if ((const uint8_t *) ptr >= arena.start && (const uint8_t *) ptr < arena.end) {
+            return arena.firstPage + ((const uint8_t *) ptr - arena.start) / PAGE_SIZE;
+        }
+    }
+    return NO_PAGE;
+}
+
+void TrampolineHeap::free(uint32_t *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard lock(mutex);
+    auto pageIndex = findPage(ptr);
+    if (pageIndex == NO_PAGE || pages[pageIndex].usedSlots == 0) {
+        DEBUG_FUNCTION_LINE_ERR("Tried to free invalid trampoline %p", ptr);
+        return;
+    }
+
+    auto &page  = pages[pageIndex];
+    bool isFull = page.freeSlots == nullptr && page.carvedSlots == getSlotsPerPage(page.sizeClass);
+
+    *ptr           = (uint32_t) (uintptr_t) page.freeSlots;
+    page.freeSlots = ptr;
+    page.usedSlots--;
+    stats.bytesInUse -= SIZE_CLASSES[page.sizeClass] * sizeof(uint32_t);
+
+    if (page.usedSlots == 0) {
+        // Let any size class use this page again.
+        if (!isFull) {
+            unlinkPartial(pageIndex);
+        }
+        emptyPages.push_back(pageIndex);
+    } else if (isFull) {
+        linkPartial(pageIndex);
+    }
+}
+
+TrampolineHeap::Stats TrampolineHeap::getStats() {
+    std::lock_guard lock(mutex);
+    return stats;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Slab allocator for the trampolines of the function patches.
+ *
+ * The memory is split into pages, each page holds slots of a single size class. The size classes match the
+ * possible trampoline shapes, so there is no per-allocation header and alloc/free are O(1) without fragmentation.
+ * Empty pages are returned and can be reused for any size class.
+ *
+ * If all pages are in use, another arena is allocated. Arenas are never freed and all of them have to be
+ * reachable via an absolute branch (< 0x02000000).
+ */
+class TrampolineHeap {
+public:
+    static constexpr uint32_t PAGE_SIZE       = 0x200;
+    static constexpr uint32_t GROW_ARENA_SIZE = 0x4000;
+
+    // In instructions (words), every jump in a trampoline takes either 1 or 4 instructions:
+    // jump to original (2, 5, 8), long jump to the replacement (4),
+    // and the process filtered trampolines (single process: 7, 10, 13, 16, game and menu: 9, 12, 15, 18).
+    // Counting the calls adds 6 instructions, the rare long shapes share the next bigger class (20, 22, 24).
+    static constexpr std::array<uint32_t, 15> SIZE_CLASSES = {2, 4, 5, 7, 8, 9, 10, 12, 13, 15, 16, 18, 20, 22, 24};
+
+    static constexpr uint32_t getSizeClassWords(uint32_t numWords) {
+        for (auto words : SIZE_CLASSES) {
+            if (words >= numWords) {
+                return words;
+            }
+        }
+        return 0;
+    }
+
+    typedef struct Stats {
+        uint32_t arenaCount;
+        uint32_t bytesTotal;
+        uint32_t bytesInUse;
+        uint32_t bytesInUsePeak;
+        uint32_t failedAllocations;
+    } Stats;
+
+    bool addArena(void *start, uint32_t size);
+
+    /**
+     * Returns 4 byte aligned memory for numWords instructions, or nullptr if no memory is left.
+     * If possible the memory is within the range of a relative branch from/to nearAddress (0 for no preference).
+     */
+    uint32_t *alloc(uint32_t numWords, uint32_t nearAddress = 0);
+
+    void free(uint32_t *ptr);
+
+    Stats getStats();
+
+private:
+    static constexpr uint32_t NO_PAGE = 0xFFFFFFFF;
+
+    typedef struct Page {
+        uint8_t *start;
+        uint32_t sizeClass;
+        uint32_t usedSlots;
+        uint32_t carvedSlots; // slots after this have never been used.
+        uint32_t *freeSlots;  // freed slots, linked through their first word.
+        uint32_t prevPartial;
+        uint32_t nextPartial;
+    } Page;
+
+    typedef struct Arena {
+        uint8_t *start;
+        uint8_t *end;
+        uint32_t firstPage;
+    } Arena;
+
+    [[nodiscard]] static uint32_t getSlotsPerPage(uint32_t sizeClass) {
+        return PAGE_SIZE / (SIZE_CLASSES[sizeClass] * sizeof(uint32_t));
+    }
+
+    bool addArenaLocked(void *start, uint32_t size);
+
+    bool growLocked();
+
+    uint32_t findPage(const uint32_t *ptr) const;
+
+    static bool isPageNear(const Page &page, uint32_t address);
+
+    uint32_t findPartialPageLocked(uint32_t sizeClass, uint32_t nearAddress);
+
+    uint32_t takeEmptyPageLocked(uint32_t nearAddress);
+
+    void linkPartial(uint32_t pageIndex);
+
+    void unlinkPartial(uint32_t pageIndex);
+
+    std::mutex mutex;
+    std::vector<Arena> arenas;
+    std::vector<Page> pages;
+    std::vector<uint32_t> emptyPages;
+    Stats stats = {};
+    std::array<uint32_t, SIZE_CLASSES.size()> partialPages = [] {
+        std::array<uint32_t, SIZE_CLASSES.size()> result{};
+        result.fill(NO_PAGE);
+        return result;
+    }();
+};
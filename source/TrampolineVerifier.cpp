@@ -0,0 +1,195 @@
+#include "TrampolineHeap.h"
+#include "TrampolineVerifier.h"
+
+/*
+ * Compile time verification of every trampoline shape. Nothing in here is executed at runtime,
+ * a trampoline that doesn't end up where it should (or gets slower) breaks the build.
+ */
+namespace {
+    constexpr FunctionPatcherTargetProcess TARGET_PROCESSES[] = {
+            FP_TARGET_PROCESS_ALL,
+            FP_TARGET_PROCESS_ROOT_RPX,
+            FP_TARGET_PROCESS_WII_U_MENU,
+            FP_TARGET_PROCESS_TVII,
+            FP_TARGET_PROCESS_E_MANUAL,
+            FP_TARGET_PROCESS_HOME_MENU,
+            FP_TARGET_PROCESS_ERROR_DISPLAY,
+            FP_TARGET_PROCESS_MINI_MIIVERSE,
+            FP_TARGET_PROCESS_BROWSER,
+            FP_TARGET_PROCESS_MIIVERSE,
+            FP_TARGET_PROCESS_ESHOP,
+            FP_TARGET_PROCESS_PFID_11,
+            FP_TARGET_PROCESS_DOWNLOAD_MANAGER,
+            FP_TARGET_PROCESS_PFID_13,
+            FP_TARGET_PROCESS_PFID_14,
+            FP_TARGET_PROCESS_GAME,
+            FP_TARGET_PROCESS_GAME_AND_MENU,
+    };
+
+    typedef struct Placement {
+        uint32_t functionAddress;
+        uint32_t replacementAddress;
+        uint32_t jumpDataAddress;
+        uint32_t jumpToOriginalAddress;
+    } Placement;
+
+    constexpr Placement PLACEMENTS[] = {
+            {0x01000000, 0x00800000, 0x00900000, 0x00900100}, // everything reachable via ba
+            {0x02800000, 0x00800000, 0x01000000, 0x01000100}, // function reachable via b
+            {0x10000000, 0x00800000, 0x00900000, 0x00900100}, // function needs a long jump
+            {0x02000000, 0x30000000, 0x01000000, 0x01000100}, // replacement needs a long jump
+            {0x10000000, 0x30000000, 0x00900000, 0x00900100}, // both need a long jump
+    };
+
+    constexpr uint32_t REPLACED_INSTRUCTIONS[] = {
+            PPCInstructions::NOP,
+            PPCInstructions::b(0x100),
+            PPCInstructions::bl(-0x100),
+            PPCInstructions::ba(0x00A00000),
+    };
+
+    // 0 for no counter, the slots of the last one cross a 64 KiB boundary with a negative low half.
+    constexpr uint32_t CALL_COUNTER_ADDRESSES[] = {0, 0x10123440, 0x1012FFC0};
+
+    constexpr TrampolineParameters Params(const Placement &placement, uint32_t replacedInstruction, FunctionPatcherTargetProcess targetProcess, uint32_t callCounterAddress) {
+        return {placement.functionAddress, replacedInstruction, placement.replacementAddress, targetProcess, 0x1005, -0x1234, callCounterAddress};
+    }
+
+    constexpr TrampolineVerifier::PathCosts Costs(const Placement &placement, uint32_t replacedInstruction, FunctionPatcherTargetProcess targetProcess, uint32_t callCounterAddress = 0) {
+        return TrampolineVerifier::verify(Params(placement, replacedInstruction, targetProcess, callCounterAddress), placement.jumpDataAddress, placement.jumpToOriginalAddress);
+    }
+
+    // Split by placement, checking everything at once exceeds the constexpr evaluation limit of the compiler.
+    constexpr bool VerifyPlacement(const Placement &placement) {
+        for (auto replacedInstruction : REPLACED_INSTRUCTIONS) {
+            for (auto targetProcess : TARGET_PROCESSES) {
+                for (auto callCounterAddress : CALL_COUNTER_ADDRESSES) {
+                    if (!Costs(placement, replacedInstruction, targetProcess, callCounterAddress).valid) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Every trampoline fits into a size class of the heap.
+    constexpr bool FitsIntoHeap() {
+        for (auto &placement : PLACEMENTS) {
+            for (auto replacedInstruction : REPLACED_INSTRUCTIONS) {
+                for (auto targetProcess : TARGET_PROCESSES) {
+                    for (auto callCounterAddress : CALL_COUNTER_ADDRESSES) {
+                        auto params = Params(placement, replacedInstruction, targetProcess, callCounterAddress);
+                        for (uint32_t address : {placement.jumpDataAddress, 0u}) {
+                            if (TrampolineHeap::getSizeClassWords(Trampolines::getJumpDataSize(params, address)) == 0 ||
+                                TrampolineHeap::getSizeClassWords(Trampolines::getJumpToOriginalSize(params, address)) == 0) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Disjoint sets of processes, the last one covers every single process.
+    constexpr FunctionPatcherTargetProcess GAME_AND_WII_U_MENU[]   = {FP_TARGET_PROCESS_GAME, FP_TARGET_PROCESS_WII_U_MENU};
+    constexpr FunctionPatcherTargetProcess GAME_AND_MENU_OR_HOME[] = {FP_TARGET_PROCESS_HOME_MENU, FP_TARGET_PROCESS_GAME_AND_MENU, FP_TARGET_PROCESS_BROWSER};
+    constexpr const FunctionPatcherTargetProcess *SINGLE_PROCESSES = TARGET_PROCESSES + 1;
+    constexpr uint32_t NUM_SINGLE_PROCESSES                        = 15;
+
+    /**
+     * Merges patches of the given processes into a dispatcher, the oldest patch has replaced replacedInstruction.
+     * Every patch has its own replacement, jump data and call counter.
+     */
+    constexpr TrampolineVerifier::PathCosts DispatcherCosts(const Placement &placement, uint32_t replacedInstruction, const FunctionPatcherTargetProcess *targetProcesses,
+                                                            uint32_t numPatches, uint32_t callCounterAddress = 0, bool parked = false) {
+        TrampolineParameters patches[TrampolineVerifier::DISPATCHER_MAX_PATCHES] = {};
+        uint32_t jumpDataAddresses[TrampolineVerifier::DISPATCHER_MAX_PATCHES]  = {};
+        for (uint32_t i = 0; i < numPatches && i < TrampolineVerifier::DISPATCHER_MAX_PATCHES; i++) {
+            jumpDataAddresses[i] = placement.jumpDataAddress + i * 0x100;
+            // Every patch jumps to the jump data of the previous one when calling the real function.
+            auto instruction = i == 0 ? replacedInstruction : PPCInstructions::ba(jumpDataAddresses[i - 1]);
+            patches[i]       = Params(placement, instruction, targetProcesses[i], callCounterAddress ? callCounterAddress + i * 0x100 : 0);
+            patches[i].replacementAddress += i * 0x1000;
+        }
+        return TrampolineVerifier::verifyDispatcher(patches, jumpDataAddresses, numPatches, placement.jumpDataAddress + 0x2000, placement.jumpDataAddress + 0x3000, parked);
+    }
+
+    constexpr bool VerifyDispatcherPlacement(const Placement &placement) {
+        for (auto replacedInstruction : REPLACED_INSTRUCTIONS) {
+            for (auto callCounterAddress : CALL_COUNTER_ADDRESSES) {
+                if (!DispatcherCosts(placement, replacedInstruction, GAME_AND_WII_U_MENU, 2, callCounterAddress).valid ||
+                    !DispatcherCosts(placement, replacedInstruction, GAME_AND_MENU_OR_HOME, 3, callCounterAddress).valid ||
+                    !DispatcherCosts(placement, replacedInstruction, GAME_AND_MENU_OR_HOME, 3, callCounterAddress, true).valid ||
+                    !DispatcherCosts(placement, replacedInstruction, SINGLE_PROCESSES, NUM_SINGLE_PROCESSES, callCounterAddress).valid) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator==(const TrampolineVerifier::PathCosts &a, const TrampolineVerifier::PathCosts &b) {
+        return a.valid == b.valid && a.replacement == b.replacement && a.original == b.original && a.realCall == b.realCall;
+    }
+
+    static_assert(VerifyPlacement(PLACEMENTS[0]), "A trampoline doesn't reach its target or doesn't count its calls correctly");
+    static_assert(VerifyPlacement(PLACEMENTS[1]), "A trampoline doesn't reach its target or doesn't count its calls correctly");
+    static_assert(VerifyPlacement(PLACEMENTS[2]), "A trampoline doesn't reach its target or doesn't count its calls correctly");
+    static_assert(VerifyPlacement(PLACEMENTS[3]), "A trampoline doesn't reach its target or doesn't count its calls correctly");
+    static_assert(VerifyPlacement(PLACEMENTS[4]), "A trampoline doesn't reach its target or doesn't count its calls correctly");
+    static_assert(VerifyDispatcherPlacement(PLACEMENTS[0]), "A dispatcher doesn't reach the targeted patch or the original function");
+    static_assert(VerifyDispatcherPlacement(PLACEMENTS[1]), "A dispatcher doesn't reach the targeted patch or the original function");
+    static_assert(VerifyDispatcherPlacement(PLACEMENTS[2]), "A dispatcher doesn't reach the targeted patch or the original function");
+    static_assert(VerifyDispatcherPlacement(PLACEMENTS[3]), "A dispatcher doesn't reach the targeted patch or the original function");
+    static_assert(VerifyDispatcherPlacement(PLACEMENTS[4]), "A dispatcher doesn't reach the targeted patch or the original function");
+    // Patches that target the same process can't be merged.
+    constexpr FunctionPatcherTargetProcess OVERLAPPING[] = {FP_TARGET_PROCESS_GAME, FP_TARGET_PROCESS_GAME_AND_MENU};
+    static_assert(!DispatcherCosts(PLACEMENTS[0], PPCInstructions::NOP, OVERLAPPING, 2).valid);
+    static_assert(FitsIntoHeap(), "A trampoline doesn't fit into any size class of the TrampolineHeap");
+    static_assert(TrampolineHeap::SIZE_CLASSES.back() == Trampolines::MAX_SIZE);
+
+    // The interpreter rejects what it can't model.
+    constexpr uint32_t UNKNOWN_LOAD[] = {PPCInstructions::lis(PPCInstructions::R11, 0x1234), PPCInstructions::lwz(PPCInstructions::R11, 0, PPCInstructions::R11)};
+    constexpr TrampolineInterpreter::Region UNKNOWN_LOAD_REGION[] = {{0x00900000, UNKNOWN_LOAD, 2}};
+    constexpr bool RunsValid(const TrampolineInterpreter::Region *region) {
+        TrampolineInterpreter::Memory memory = {0x1004EDCC, 15, 0, 0, {}};
+        return TrampolineInterpreter::run(region, 1, 0x00900000, memory).valid;
+    }
+    static_assert(!RunsValid(UNKNOWN_LOAD_REGION));
+    constexpr uint32_t ENDLESS_LOOP[] = {PPCInstructions::b(0)};
+    constexpr TrampolineInterpreter::Region ENDLESS_LOOP_REGION[] = {{0x00900000, ENDLESS_LOOP, 1}};
+    static_assert(!RunsValid(ENDLESS_LOOP_REGION));
+
+    /*
+     * Instructions per path {valid, replacement, original, realCall}, including the patched instruction at the function entry.
+     * Update these numbers only on purpose, they are the cost of each hook variant.
+     */
+    // Without a process filter the entry jumps directly to the replacement.
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::NOP, FP_TARGET_PROCESS_ALL) == TrampolineVerifier::PathCosts{true, 1, 0, 2});
+    static_assert(Costs(PLACEMENTS[2], PPCInstructions::NOP, FP_TARGET_PROCESS_ALL) == TrampolineVerifier::PathCosts{true, 1, 0, 5});
+    static_assert(Costs(PLACEMENTS[3], PPCInstructions::NOP, FP_TARGET_PROCESS_ALL) == TrampolineVerifier::PathCosts{true, 5, 0, 2});
+    // Single process.
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 6, 7, 2});
+    static_assert(Costs(PLACEMENTS[1], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 6, 7, 2});
+    static_assert(Costs(PLACEMENTS[2], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 6, 10, 5});
+    static_assert(Costs(PLACEMENTS[4], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 9, 10, 5});
+    // Game and menu, the game pays for the second compare.
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME_AND_MENU) == TrampolineVerifier::PathCosts{true, 8, 9, 2});
+    static_assert(Costs(PLACEMENTS[4], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME_AND_MENU) == TrampolineVerifier::PathCosts{true, 11, 12, 5});
+    // Relocated branches leave the trampoline at their target.
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::b(0x100), FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 6, 6, 1});
+    static_assert(Costs(PLACEMENTS[2], PPCInstructions::b(0x100), FP_TARGET_PROCESS_GAME) == TrampolineVerifier::PathCosts{true, 6, 9, 4});
+    // Counting the calls costs 6 instructions, but only for calls of the replacement.
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::NOP, FP_TARGET_PROCESS_ALL, 0x10123440) == TrampolineVerifier::PathCosts{true, 8, 0, 2});
+    static_assert(Costs(PLACEMENTS[0], PPCInstructions::NOP, FP_TARGET_PROCESS_GAME, 0x10123440) == TrampolineVerifier::PathCosts{true, 12, 7, 2});
+    // A dispatcher costs the same for any number of merged patches, every patch it replaces would cost 5 or more instructions.
+    static_assert(DispatcherCosts(PLACEMENTS[0], PPCInstructions::NOP, GAME_AND_WII_U_MENU, 2) == TrampolineVerifier::PathCosts{true, 10, 11, 2});
+    static_assert(DispatcherCosts(PLACEMENTS[0], PPCInstructions::NOP, SINGLE_PROCESSES, NUM_SINGLE_PROCESSES) == TrampolineVerifier::PathCosts{true, 10, 11, 2});
+    static_assert(DispatcherCosts(PLACEMENTS[4], PPCInstructions::NOP, SINGLE_PROCESSES, NUM_SINGLE_PROCESSES) == TrampolineVerifier::PathCosts{true, 13, 14, 5});
+    static_assert(DispatcherCosts(PLACEMENTS[0], PPCInstructions::NOP, SINGLE_PROCESSES, NUM_SINGLE_PROCESSES, 0x10123440) == TrampolineVerifier::PathCosts{true, 16, 11, 2});
+    // A parked dispatcher passes every check of the chain.
+    static_assert(DispatcherCosts(PLACEMENTS[0], PPCInstructions::NOP, GAME_AND_MENU_OR_HOME, 3, 0, true) == TrampolineVerifier::PathCosts{true, 26, 27, 2});
+} // namespace
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "Trampolines.h"
+#include <cstdint>
+
+/**
+ * Interpreter for the PowerPC subset the trampolines are made of
+ * (lis/addis, addi, add, ori, rlwinm, lwz, stw, cmpwi, beq, b/ba/bl, mfspr UPIR, mtctr, bctr/bctrl).
+ *
+ * The code is executed from a set of regions until control leaves all of them. The only memory is the word OSGetUPID
+ * reads (read-only), the slots of the call counter and the regions themselves (read-only, e.g. the table of a dispatcher):
+ * a lwz from the UPID address returns the given UPID, any other access (or any unknown instruction) makes the run invalid. Everything is constexpr, so the checks run at compile time and need no console.
+ */
+class TrampolineInterpreter {
+public:
+    static constexpr uint32_t MAX_STEPS = 64;
+
+    typedef struct Region {
+        uint32_t address;
+        const uint32_t *code;
+        uint32_t size; // in instructions
+    } Region;
+
+    typedef struct Memory {
+        uint32_t upidAddress;
+        uint32_t upid;
+        uint32_t coreId;         // value of UPIR
+        uint32_t counterAddress; // address of a CallCounter, 0 if there is none
+        uint32_t counters[CallCounter::CORE_COUNT];
+    } Memory;
+
+    typedef struct Result {
+        bool valid;
+        uint32_t exitAddress;  // first address outside of the regions
+        uint32_t instructions; // number of executed instructions
+    } Result;
+
+    static constexpr Result run(const Region *regions, uint32_t numRegions, uint32_t startAddress, Memory &memory) {
+        uint32_t gpr[32] = {};
+        uint32_t ctr     = 0;
+        bool cr0Eq       = false;
+        uint32_t pc      = startAddress;
+        uint32_t count   = 0;
+
+        while (true) {
+            const uint32_t *instructionPtr = findInstruction(regions, numRegions, pc);
+            if (instructionPtr == nullptr) {
+                return {true, pc, count};
+            }
+            if (count >= MAX_STEPS) {
+                return {false, pc, count};
+            }
+            count++;
+
+            uint32_t instruction = *instructionPtr;
+            uint32_t rD          = (instruction >> 21) & 0x1F;
+            uint32_t rA          = (instruction >> 16) & 0x1F;
+            uint32_t uimm        = instruction & 0xFFFF;
+            auto simm            = (int32_t) (int16_t) uimm;
+
+            switch (instruction >> 26) {
+                case 15: // addis/lis
+                    gpr[rD] = (rA ? gpr[rA] : 0) + (uimm << 16);
+                    pc += 4;
+                    break;
+                case 14: // addi/li
+                    gpr[rD] = (rA ? gpr[rA] : 0) + simm;
+                    pc += 4;
+                    break;
+                case 21: { // rlwinm
+                    uint32_t shift     = (instruction >> 11) & 0x1F;
+                    uint32_t maskBegin = (instruction >> 6) & 0x1F;
+                    uint32_t maskEnd   = (instruction >> 1) & 0x1F;
+                    if ((instruction & 1) != 0 || maskBegin > maskEnd) {
+                        return {false, pc, count};
+                    }
+                    uint32_t rotated = shift ? (gpr[rD] << shift) | (gpr[rD] >> (32 - shift)) : gpr[rD];
+                    uint32_t mask    = (0xFFFFFFFF >> maskBegin) & (0xFFFFFFFF << (31 - maskEnd));
+                    gpr[rA]          = rotated & mask;
+                    pc += 4;
+                    break;
+                }
+                case 24: // ori/nop
+                    gpr[rA] = gpr[rD] | uimm;
+                    pc += 4;
+                    break;
+                case 32: { // lwz
+                    uint32_t address = (rA ? gpr[rA] : 0) + simm;
+                    if (address == memory.upidAddress) {
+                        gpr[rD] = memory.upid;
+                    } else if (auto counter = findCounter(memory, address)) {
+                        gpr[rD] = *counter;
+                    } else if (auto word = findInstruction(regions, numRegions, address)) {
+                        gpr[rD] = *word;
+                    } else {
+                        return {false, pc, count};
+                    }
+                    pc += 4;
+                    break;
+                }
+                case 36: { // stw, only the counter can be written
+                    auto counter = findCounter(memory, (rA ? gpr[rA] : 0) + simm);
+                    if (counter == nullptr) {
+                        return {false, pc, count};
+                    }
+                    *counter = gpr[rD];
+                    pc += 4;
+                    break;
+                }
+                case 11: // cmpwi, only cr0 is tracked
+                    if (((instruction >> 23) & 7) != 0 || (instruction & 0x00600000) != 0) {
+                        return {false, pc, count};
+                    }
+                    cr0Eq = (int32_t) gpr[rA] == simm;
+                    pc += 4;
+                    break;
+                case 16: // bc, only beq and "branch always" without link
+                    if ((instruction & 3) != 0) {
+                        return {false, pc, count};
+                    }
+                    if (rD == 12 && rA == 2) {
+                        pc = cr0Eq ? pc + (simm & ~3) : pc + 4;
+                    } else if (rD == 20) {
+                        pc += simm & ~3;
+                    } else {
+                        return {false, pc, count};
+                    }
+                    break;
+                case 18: // b/ba/bl/bla, a call leaves the trampoline as well
+                    pc = PPCInstructions::getBranchTarget(instruction, pc);
+                    break;
+                case 19: // bctr/bctrl
+                    if (instruction != PPCInstructions::BCTR && instruction != PPCInstructions::BCTRL) {
+                        return {false, pc, count};
+                    }
+                    pc = ctr & ~3;
+                    break;
+                case 31: // add, mfspr UPIR, mtctr
+                    if ((instruction & 0xFC0007FF) == PPCInstructions::add(PPCInstructions::R0, PPCInstructions::R0, PPCInstructions::R0)) {
+                        gpr[rD] = gpr[rA] + gpr[(instruction >> 11) & 0x1F];
+                    } else if ((instruction & 0xFC1FFFFF) == PPCInstructions::mtctr(PPCInstructions::R0)) {
+                        ctr = gpr[rD];
+                    } else if ((instruction & 0xFC1FFFFF) == PPCInstructions::mfspr(PPCInstructions::R0, PPCInstructions::UPIR)) {
+                        gpr[rD] = memory.coreId;
+                    } else {
+                        return {false, pc, count};
+                    }
+                    pc += 4;
+                    break;
+                default:
+                    return {false, pc, count};
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t *findCounter(Memory &memory, uint32_t address) {
+        if (memory.counterAddress == 0 || address < memory.counterAddress) {
+            return nullptr;
+        }
+        uint32_t offset = address - memory.counterAddress;
+        if (offset % CallCounter::SLOT_SIZE != 0 || offset / CallCounter::SLOT_SIZE >= CallCounter::CORE_COUNT) {
+            return nullptr;
+        }
+        return &memory.counters[offset / CallCounter::SLOT_SIZE];
+    }
+
+    static constexpr const uint32_t *findInstruction(const Region *regions, uint32_t numRegions, uint32_t address) {
+        for (uint32_t i = 0; i < numRegions; i++) {
+            if (address >= regions[i].address && address < regions[i].address + regions[i].size * 4 && (address & 3) == 0) {
+                return &regions[i].code[(address - regions[i].address) / 4];
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * Executes the trampolines of a patch (function entry, jump data and jump to original) like they are placed in memory
+ * and checks where control ends up for every UPID.
+ */
+class TrampolineVerifier {
+public:
+    typedef struct PathCosts {
+        bool valid;
+        uint32_t replacement; // instructions from the function entry to the replacement (worst case), 0 if never taken
+        uint32_t original;    // instructions from the function entry back to the original function (worst case), 0 if never taken
+        uint32_t realCall;    // instructions of a call of the real function via the jump to original
+    } PathCosts;
+
+    /**
+     * Address at which the original function continues after the replaced instruction has been executed.
+     */
+    static constexpr uint32_t getOriginalContinuation(const TrampolineParameters &params) {
+        if (PPCInstructions::isUnconditionalBranch(params.replacedInstruction)) {
+            return PPCInstructions::getBranchTarget(params.replacedInstruction, params.functionAddress);
+        }
+        return params.functionAddress + 4;
+    }
+
+    static constexpr TrampolineInterpreter::Result runFromEntry(const TrampolineParameters &params, uint32_t jumpDataAddress, TrampolineInterpreter::Memory &memory) {
+        uint32_t entry                           = Trampolines::buildEntryInstruction(params, jumpDataAddress);
+        uint32_t jumpData[Trampolines::MAX_SIZE] = {};
+        uint32_t jumpDataSize                    = Trampolines::buildJumpData(jumpData, jumpDataAddress, params);
+
+        TrampolineInterpreter::Region regions[] = {
+                {params.functionAddress, &entry, 1},
+                {jumpDataAddress, jumpData, Trampolines::needsJumpData(params) ? jumpDataSize : 0},
+        };
+        return TrampolineInterpreter::run(regions, 2, params.functionAddress, memory);
+    }
+
+    static constexpr TrampolineInterpreter::Result runRealCall(const TrampolineParameters &params, uint32_t jumpToOriginalAddress, TrampolineInterpreter::Memory &memory) {
+        uint32_t jumpToOriginal[Trampolines::MAX_SIZE] = {};
+        uint32_t size                                  = Trampolines::buildJumpToOriginal(jumpToOriginal, jumpToOriginalAddress, params);
+
+        TrampolineInterpreter::Region regions[] = {{jumpToOriginalAddress, jumpToOriginal, size}};
+        return TrampolineInterpreter::run(regions, 1, jumpToOriginalAddress, memory);
+    }
+
+    /**
+     * Runs the patch for every UPID (0-15) and returns the cost per path.
+     * valid is false if any run ends anywhere else than at the replacement or the continuation of the original function,
+     * or if the slot of the current core of the call counter is not incremented exactly once for every call of the replacement.
+     * The UPIDs are spread over the cores, so every core calls the replacement if the patch targets multiple processes.
+     */
+    static constexpr PathCosts verify(const TrampolineParameters &params, uint32_t jumpDataAddress, uint32_t jumpToOriginalAddress) {
+        PathCosts result = {true, 0, 0, 0};
+        for (uint32_t upid = 0; upid < 16; upid++) {
+            uint32_t coreId                      = upid % CallCounter::CORE_COUNT;
+            TrampolineInterpreter::Memory memory = {getUPIDAddress(params), upid, coreId, params.callCounterAddress, {COUNTER_START, COUNTER_START, COUNTER_START}};
+            auto run                             = runFromEntry(params, jumpDataAddress, memory);
+            bool replace                         = Trampolines::isTargetedProcess(params.targetProcess, upid);
+            auto &cost                           = replace ? result.replacement : result.original;
+            uint32_t exit                        = replace ? params.replacementAddress : getOriginalContinuation(params);
+            if (!run.valid || run.exitAddress != exit || !isCounterIncremented(memory, replace && params.callCounterAddress != 0)) {
+                result.valid = false;
+                return result;
+            }
+            if (run.instructions > cost) {
+                cost = run.instructions;
+            }
+        }
+
+        TrampolineInterpreter::Memory memory = {getUPIDAddress(params), 0, 0, params.callCounterAddress, {COUNTER_START, COUNTER_START, COUNTER_START}};
+        auto realCall                        = runRealCall(params, jumpToOriginalAddress, memory);
+        if (!realCall.valid || realCall.exitAddress != getOriginalContinuation(params) || !isCounterIncremented(memory, false)) {
+            result.valid = false;
+            return result;
+        }
+        result.realCall = realCall.instructions;
+        return result;
+    }
+
+    static constexpr uint32_t DISPATCHER_MAX_PATCHES = Trampolines::DISPATCHER_TABLE_SIZE;
+
+    /**
+     * Runs a dispatcher over the given patches of one function (oldest first) for every UPID.
+     * A targeted UPID has to end up at the replacement of its patch (counted once if the patch counts its calls), every other UPID
+     * in the original function via the jump to original of the oldest patch.
+     * A parked dispatcher jumps to the jump data of the newest patch for every UPID, the same paths are taken via the chain.
+     */
+    static constexpr PathCosts verifyDispatcher(const TrampolineParameters *patches, const uint32_t *jumpDataAddresses, uint32_t numPatches,
+                                                uint32_t jumpToOriginalAddress, uint32_t dispatcherAddress, bool parked = false) {
+        PathCosts result                                   = {false, 0, 0, 0};
+        uint32_t table[Trampolines::DISPATCHER_TABLE_SIZE] = {};
+        if (numPatches == 0 || numPatches > DISPATCHER_MAX_PATCHES || !Trampolines::buildDispatcherTable(table, patches, jumpDataAddresses, numPatches, jumpToOriginalAddress)) {
+            return result;
+        }
+        if (parked) {
+            for (auto &target : table) {
+                target = jumpDataAddresses[numPatches - 1];
+            }
+        }
+        auto &oldest = patches[0];
+
+        uint32_t entry                                                   = PPCInstructions::ba(dispatcherAddress);
+        uint32_t dispatcher[Trampolines::DISPATCHER_SIZE]                = {};
+        uint32_t jumpToOriginal[Trampolines::MAX_SIZE]                   = {};
+        uint32_t jumpData[DISPATCHER_MAX_PATCHES][Trampolines::MAX_SIZE] = {};
+        Trampolines::buildDispatcher(dispatcher, dispatcherAddress, oldest, table);
+
+        TrampolineInterpreter::Region regions[3 + DISPATCHER_MAX_PATCHES] = {
+                {oldest.functionAddress, &entry, 1},
+                {dispatcherAddress, dispatcher, Trampolines::DISPATCHER_SIZE},
+                {jumpToOriginalAddress, jumpToOriginal, Trampolines::buildJumpToOriginal(jumpToOriginal, jumpToOriginalAddress, oldest)},
+        };
+        for (uint32_t i = 0; i < numPatches; i++) {
+            regions[3 + i] = {jumpDataAddresses[i], jumpData[i], Trampolines::buildJumpData(jumpData[i], jumpDataAddresses[i], patches[i])};
+        }
+
+        result.valid = true;
+        for (uint32_t upid = 0; upid < Trampolines::DISPATCHER_TABLE_SIZE; upid++) {
+            const TrampolineParameters *targeted = nullptr;
+            for (uint32_t i = 0; i < numPatches; i++) {
+                if (Trampolines::isTargetedProcess(patches[i].targetProcess, upid)) {
+                    targeted = &patches[i];
+                }
+            }
+            uint32_t counterAddress              = targeted ? targeted->callCounterAddress : 0;
+            TrampolineInterpreter::Memory memory = {getUPIDAddress(oldest), upid, upid % CallCounter::CORE_COUNT, counterAddress, {COUNTER_START, COUNTER_START, COUNTER_START}};
+            auto run                             = TrampolineInterpreter::run(regions, 3 + numPatches, oldest.functionAddress, memory);
+            auto &cost                           = targeted ? result.replacement : result.original;
+            uint32_t exit                        = targeted ? targeted->replacementAddress : getOriginalContinuation(oldest);
+            if (!run.valid || run.exitAddress != exit || !isCounterIncremented(memory, counterAddress != 0)) {
+                result.valid = false;
+                return result;
+            }
+            if (run.instructions > cost) {
+                cost = run.instructions;
+            }
+        }
+
+        TrampolineInterpreter::Memory memory = {getUPIDAddress(oldest), 0, 0, 0, {}};
+        auto realCall                        = TrampolineInterpreter::run(regions, 3 + numPatches, jumpToOriginalAddress, memory);
+        if (!realCall.valid || realCall.exitAddress != getOriginalContinuation(oldest)) {
+            result.valid = false;
+            return result;
+        }
+        result.realCall = realCall.instructions;
+        return result;
+    }
+
+private:
+    static constexpr uint32_t COUNTER_START = 0x1234;
+
+    // Only the slot of the current core may change.
+    static constexpr bool isCounterIncremented(const TrampolineInterpreter::Memory &memory, bool incremented) {
+        for (uint32_t i = 0; i < CallCounter::CORE_COUNT; i++) {
+            if (memory.counters[i] != (incremented && i == memory.coreId ? COUNTER_START + 1 : COUNTER_START)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr uint32_t getUPIDAddress(const TrampolineParameters &params) {
+        return (params.upidAddressHigh << 16) + params.upidAddressLow;
+    }
+};
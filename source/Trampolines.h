@@ -0,0 +1,274 @@
+#pragma once
+
+#include "CallCounter.h"
+#include "utils/PPCInstructions.h"
+#include <cstdint>
+#include <function_patcher/fpatching_defines.h>
+
+typedef struct TrampolineParameters {
+    uint32_t functionAddress;     // effective address of the patched function
+    uint32_t replacedInstruction; // instruction at functionAddress before it was patched
+    uint32_t replacementAddress;
+    FunctionPatcherTargetProcess targetProcess;
+    uint32_t upidAddressHigh; // the UPID is loaded via "lis r11, upidAddressHigh; lwz r11, upidAddressLow(r11)"
+    int32_t upidAddressLow;
+    uint32_t callCounterAddress; // address of a CallCounter, 0 if the calls of the replacement are not counted
+} TrampolineParameters;
+
+/**
+ * Builds the trampolines of a function patch. Every jump uses the shortest encoding that reaches its target
+ * from the address the trampoline is placed at (ba, b or lis/ori/mtctr/bctr).
+ *
+ * An address of 0 means the location is not known yet, this results in the largest possible size.
+ */
+class Trampolines {
+public:
+    static constexpr uint32_t MAX_SIZE = 24;
+
+    // A dispatcher is 8 instructions followed by one target per UPID.
+    static constexpr uint32_t DISPATCHER_CODE_SIZE  = 8;
+    static constexpr uint32_t DISPATCHER_TABLE_SIZE = 16;
+    static constexpr uint32_t DISPATCHER_SIZE       = DISPATCHER_CODE_SIZE + DISPATCHER_TABLE_SIZE;
+
+    static constexpr bool isRelativeBranchPossible(uint32_t address, uint32_t target) {
+        return address != 0 && PPCInstructions::isInBranchRange((int32_t) (target - address));
+    }
+
+    /**
+     * Writes the shortest jump from address to target and returns the number of instructions.
+     * The long version clobbers r11 and CTR.
+     */
+    static constexpr uint32_t writeBranch(uint32_t *out, uint32_t address, uint32_t target, bool link) {
+        if (PPCInstructions::isInAbsoluteBranchRange(target)) {
+            out[0] = PPCInstructions::ba(target, link);
+            return 1;
+        }
+        if (isRelativeBranchPossible(address, target)) {
+            out[0] = PPCInstructions::b((int32_t) (target - address), link);
+            return 1;
+        }
+        out[0] = PPCInstructions::lis(PPCInstructions::R11, target >> 16);
+        out[1] = PPCInstructions::ori(PPCInstructions::R11, PPCInstructions::R11, target & 0xFFFF);
+        out[2] = PPCInstructions::mtctr(PPCInstructions::R11);
+        out[3] = link ? PPCInstructions::BCTRL : PPCInstructions::BCTR;
+        return 4;
+    }
+
+    /**
+     * Writes an instruction that has been at "from" to "address". Unconditional branches are re-encoded so they still reach their target.
+     */
+    static constexpr uint32_t writeRelocatedInstruction(uint32_t *out, uint32_t address, uint32_t instruction, uint32_t from) {
+        if (!PPCInstructions::isUnconditionalBranch(instruction)) {
+            out[0] = instruction;
+            return 1;
+        }
+        return writeBranch(out, address, PPCInstructions::getBranchTarget(instruction, from), PPCInstructions::isLink(instruction));
+    }
+
+    /**
+     * Increments the slot of the current core of the CallCounter at counterAddress, clobbers r11 and r12.
+     * Each core only writes its own cache line, so no synchronisation is needed.
+     */
+    static constexpr uint32_t writeCallCounterIncrement(uint32_t *out, uint32_t counterAddress) {
+        auto low = PPCInstructions::getAddressLow(counterAddress);
+        out[0]   = PPCInstructions::mfspr(PPCInstructions::R12, PPCInstructions::UPIR);
+        out[1]   = PPCInstructions::slwi(PPCInstructions::R12, PPCInstructions::R12, CallCounter::SLOT_SHIFT);
+        out[2]   = PPCInstructions::addis(PPCInstructions::R12, PPCInstructions::R12, PPCInstructions::getAddressHigh(counterAddress));
+        out[3]   = PPCInstructions::lwz(PPCInstructions::R11, low, PPCInstructions::R12);
+        out[4]   = PPCInstructions::addi(PPCInstructions::R11, PPCInstructions::R11, 1);
+        out[5]   = PPCInstructions::stw(PPCInstructions::R11, low, PPCInstructions::R12);
+        return 6;
+    }
+
+    /**
+     * True if the replacement should be called in the process with the given UPID.
+     */
+    static constexpr bool isTargetedProcess(FunctionPatcherTargetProcess targetProcess, uint32_t upid) {
+        switch (targetProcess) {
+            case FP_TARGET_PROCESS_ALL:
+                return true;
+            case FP_TARGET_PROCESS_GAME_AND_MENU:
+                return upid == FP_TARGET_PROCESS_WII_U_MENU || upid == FP_TARGET_PROCESS_GAME;
+            default:
+                return upid == (uint32_t) targetProcess;
+        }
+    }
+
+    /**
+     * A trampoline is needed if the replacement is too far away, if only certain processes should be redirected
+     * or if the calls are counted.
+     */
+    static constexpr bool needsJumpData(const TrampolineParameters &params) {
+        if (params.targetProcess != FP_TARGET_PROCESS_ALL || params.callCounterAddress != 0) {
+            return true;
+        }
+        return !PPCInstructions::isInAbsoluteBranchRange(params.replacementAddress) && !isRelativeBranchPossible(params.functionAddress, params.replacementAddress);
+    }
+
+    /**
+     * Executes the replaced instruction and continues with the original function.
+     */
+    static constexpr uint32_t buildJumpToOriginal(uint32_t *out, uint32_t address, const TrampolineParameters &params) {
+        uint32_t offset = writeRelocatedInstruction(out, address, params.replacedInstruction, params.functionAddress);
+        offset += writeBranch(out + offset, address + offset * 4, params.functionAddress + 4, false);
+        return offset;
+    }
+
+    /**
+     * Jumps to the replacement, if a process is set only if it matches the current UPID. Otherwise the original function is executed.
+     * Only calls that end up in the replacement are counted.
+     * outReplacementPathIndex receives the index of the first instruction the targeted process executes after the check.
+     */
+    static constexpr uint32_t buildJumpData(uint32_t *out, uint32_t address, const TrampolineParameters &params, uint32_t *outReplacementPathIndex = nullptr) {
+        uint32_t offset = 0;
+        if (params.targetProcess != FP_TARGET_PROCESS_ALL) {
+            out[offset++] = PPCInstructions::lis(PPCInstructions::R11, params.upidAddressHigh);
+            out[offset++] = PPCInstructions::lwz(PPCInstructions::R11, params.upidAddressLow, PPCInstructions::R11);
+
+            // The branches to the replacement are written once the jump to the original function has been written.
+            uint32_t branchesToReplacement[2]   = {};
+            uint32_t numBranchesToReplacement = 0;
+            if (params.targetProcess == FP_TARGET_PROCESS_GAME_AND_MENU) {
+                out[offset++]                                       = PPCInstructions::cmpwi(PPCInstructions::CR0, PPCInstructions::R11, FP_TARGET_PROCESS_WII_U_MENU);
+                branchesToReplacement[numBranchesToReplacement++] = offset++;
+                out[offset++]                                       = PPCInstructions::cmpwi(PPCInstructions::CR0, PPCInstructions::R11, FP_TARGET_PROCESS_GAME);
+                branchesToReplacement[numBranchesToReplacement++] = offset++;
+            } else {
+                out[offset++]                                       = PPCInstructions::cmpwi(PPCInstructions::CR0, PPCInstructions::R11, params.targetProcess);
+                branchesToReplacement[numBranchesToReplacement++] = offset++;
+            }
+
+            offset += buildJumpToOriginal(out + offset, address + offset * 4, params);
+
+            for (uint32_t i = 0; i < numBranchesToReplacement; i++) {
+                out[branchesToReplacement[i]] = PPCInstructions::beq((int32_t) ((offset - branchesToReplacement[i]) * 4));
+            }
+        }
+        if (outReplacementPathIndex) {
+            *outReplacementPathIndex = offset;
+        }
+        if (params.callCounterAddress != 0) {
+            offset += writeCallCounterIncrement(out + offset, params.callCounterAddress);
+        }
+        offset += writeBranch(out + offset, address + offset * 4, params.replacementAddress, false);
+        return offset;
+    }
+
+    /**
+     * Instruction that is written to the function entry, jumpDataAddress is only used if needsJumpData() is true.
+     */
+    static constexpr uint32_t buildEntryInstruction(const TrampolineParameters &params, uint32_t jumpDataAddress) {
+        if (needsJumpData(params)) {
+            return PPCInstructions::ba(jumpDataAddress);
+        }
+        // The replacement can be reached directly from the function entry (via ba or b).
+        uint32_t result = 0;
+        writeBranch(&result, params.functionAddress, params.replacementAddress, false);
+        return result;
+    }
+
+    /**
+     * Address in the jump data of a patch from which on the call is counted and the replacement is called.
+     */
+    static constexpr uint32_t getReplacementPathAddress(const TrampolineParameters &params, uint32_t jumpDataAddress) {
+        uint32_t buffer[MAX_SIZE] = {};
+        uint32_t index            = 0;
+        buildJumpData(buffer, jumpDataAddress, params, &index);
+        return jumpDataAddress + index * 4;
+    }
+
+    /**
+     * Fills the table of a dispatcher. The target of a UPID is the replacement path of the patch that targets it,
+     * or defaultTarget if no patch does. Returns false if a UPID is targeted by more than one patch.
+     */
+    static constexpr bool buildDispatcherTable(uint32_t *table, const TrampolineParameters *patches, const uint32_t *jumpDataAddresses, uint32_t numPatches, uint32_t defaultTarget) {
+        for (uint32_t upid = 0; upid < DISPATCHER_TABLE_SIZE; upid++) {
+            table[upid]     = defaultTarget;
+            bool isTargeted = false;
+            for (uint32_t i = 0; i < numPatches; i++) {
+                if (!isTargetedProcess(patches[i].targetProcess, upid)) {
+                    continue;
+                }
+                if (isTargeted) {
+                    return false;
+                }
+                isTargeted  = true;
+                table[upid] = getReplacementPathAddress(patches[i], jumpDataAddresses[i]);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Loads the UPID once and jumps to table[UPID], the table is placed right after the code.
+     * Replaces the checks of multiple process filtered patches, the cost doesn't depend on the number of patches.
+     * Clobbers r11, r12 and CTR.
+     */
+    static constexpr uint32_t buildDispatcher(uint32_t *out, uint32_t address, const TrampolineParameters &params, const uint32_t *table) {
+        uint32_t tableAddress = address + DISPATCHER_CODE_SIZE * 4;
+        out[0]                = PPCInstructions::lis(PPCInstructions::R11, params.upidAddressHigh);
+        out[1]                = PPCInstructions::lwz(PPCInstructions::R11, params.upidAddressLow, PPCInstructions::R11);
+        // (UPID & 15) * 4
+        out[2] = PPCInstructions::rlwinm(PPCInstructions::R11, PPCInstructions::R11, 2, 26, 29);
+        out[3] = PPCInstructions::lis(PPCInstructions::R12, PPCInstructions::getAddressHigh(tableAddress));
+        out[4] = PPCInstructions::add(PPCInstructions::R12, PPCInstructions::R12, PPCInstructions::R11);
+        out[5] = PPCInstructions::lwz(PPCInstructions::R12, PPCInstructions::getAddressLow(tableAddress), PPCInstructions::R12);
+        out[6] = PPCInstructions::mtctr(PPCInstructions::R12);
+        out[7] = PPCInstructions::BCTR;
+        for (uint32_t i = 0; i < DISPATCHER_TABLE_SIZE; i++) {
+            out[DISPATCHER_CODE_SIZE + i] = table[i];
+        }
+        return DISPATCHER_SIZE;
+    }
+
+    static constexpr uint32_t getJumpToOriginalSize(const TrampolineParameters &params, uint32_t address) {
+        uint32_t buffer[MAX_SIZE] = {};
+        return buildJumpToOriginal(buffer, address, params);
+    }
+
+    static constexpr uint32_t getJumpDataSize(const TrampolineParameters &params, uint32_t address) {
+        uint32_t buffer[MAX_SIZE] = {};
+        return buildJumpData(buffer, address, params);
+    }
+
+    static constexpr uint32_t getJumpDataInstruction(const TrampolineParameters &params, uint32_t address, uint32_t index) {
+        uint32_t buffer[MAX_SIZE] = {};
+        buildJumpData(buffer, address, params);
+        return buffer[index];
+    }
+};
+
+namespace TrampolineChecks {
+    constexpr TrampolineParameters Params(uint32_t functionAddress, uint32_t replacedInstruction, uint32_t replacementAddress, FunctionPatcherTargetProcess targetProcess) {
+        return {functionAddress, replacedInstruction, replacementAddress, targetProcess, 0x1005, -0x1234, 0};
+    }
+
+    // Jump to original: short (absolute/relative), long, relocated branch that doesn't reach anymore.
+    static_assert(Trampolines::getJumpToOriginalSize(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_ALL), 0x00900000) == 2);
+    static_assert(Trampolines::getJumpToOriginalSize(Params(0x02800000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_ALL), 0x01000000) == 2);
+    static_assert(Trampolines::getJumpToOriginalSize(Params(0x10000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_ALL), 0x00900000) == 5);
+    static_assert(Trampolines::getJumpToOriginalSize(Params(0x10000000, PPCInstructions::b(0x100), 0x00800000, FP_TARGET_PROCESS_ALL), 0x00900000) == 8);
+    static_assert(Trampolines::getJumpToOriginalSize(Params(0x10000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_ALL), 0) == 5);
+
+    // The entry branches directly to the replacement if possible.
+    static_assert(!Trampolines::needsJumpData(Params(0x10000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_ALL)));
+    static_assert(!Trampolines::needsJumpData(Params(0x10000000, PPCInstructions::NOP, 0x10100000, FP_TARGET_PROCESS_ALL)));
+    static_assert(Trampolines::needsJumpData(Params(0x02000000, PPCInstructions::NOP, 0x30000000, FP_TARGET_PROCESS_ALL)));
+    static_assert(Trampolines::needsJumpData(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME)));
+
+    // Process filtered trampolines.
+    static_assert(Trampolines::getJumpDataSize(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000) == 7);
+    static_assert(Trampolines::getJumpDataSize(Params(0x10000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000) == 10);
+    static_assert(Trampolines::getJumpDataSize(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME_AND_MENU), 0x00900000) == 9);
+    static_assert(Trampolines::getJumpDataSize(Params(0x10000000, PPCInstructions::b(0x100), 0x20000000, FP_TARGET_PROCESS_GAME_AND_MENU), 0) == 18);
+    static_assert(Trampolines::getJumpDataInstruction(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000, 0) == 0x3d601005);
+    static_assert(Trampolines::getJumpDataInstruction(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000, 1) == 0x816bedcc);
+    static_assert(Trampolines::getJumpDataInstruction(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000, 3) == 0x4182000c);
+    static_assert(Trampolines::getJumpDataInstruction(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME_AND_MENU), 0x00900000, 3) == 0x41820014);
+    static_assert(Trampolines::getJumpDataInstruction(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME_AND_MENU), 0x00900000, 8) == 0x48800002);
+
+    // The targeted process continues right after the check.
+    static_assert(Trampolines::getReplacementPathAddress(Params(0x01000000, PPCInstructions::NOP, 0x00800000, FP_TARGET_PROCESS_GAME), 0x00900000) == 0x00900018);
+    static_assert(Trampolines::getReplacementPathAddress(Params(0x02000000, PPCInstructions::NOP, 0x30000000, FP_TARGET_PROCESS_ALL), 0x00900000) == 0x00900000);
+    static_assert(Trampolines::DISPATCHER_SIZE <= Trampolines::MAX_SIZE);
+} // namespace TrampolineChecks
@@ -1,33 +1,51 @@
 #include "export.h"
 #include "PatchedFunctionData.h"
+#include "fpatching_defines_ext.h"
 #include "function_patcher.h"
 #include "utils/globals.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <mutex>
-#include <ranges>
 #include <vector>
 
 #include <wums/exports.h>
 
 WUT_CHECK_OFFSET(function_replacement_data_v2_t, 0x00, VERSION);
 WUT_CHECK_OFFSET(function_replacement_data_v3_t, 0x00, version);
+WUT_CHECK_OFFSET(function_replacement_data_v4_t, 0x00, version);
+WUT_CHECK_OFFSET(function_replacement_data_v4_t, 0x1C, ReplaceInRPX);
+WUT_CHECK_OFFSET(function_replacement_data_v4_t, 0x30, flags);
+static_assert(offsetof(function_replacement_data_v4_t, ReplaceInRPX) == offsetof(function_replacement_data_v3_t, ReplaceInRPX));
+static_assert(offsetof(function_replacement_data_v4_t, flags) == sizeof(function_replacement_data_v3_t));
+WUT_CHECK_SIZE(FunctionPatcherTiming, 0x10);
+WUT_CHECK_SIZE(FunctionPatcherStatistics, 0x88);
+WUT_CHECK_SIZE(FunctionPatcherPatchStatistics, 0x28);
 
-FunctionPatcherStatus FPAddFunctionPatch(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle, bool *outHasBeenPatched) {
+static FunctionPatcherStatus CreatePatchedFunctionData(function_replacement_data_t *function_data, std::shared_ptr<PatchedFunctionData> &outFunctionData) {
     if (function_data == nullptr) {
         DEBUG_FUNCTION_LINE_ERR("function_data was NULL");
         return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
     }
 
-    if (function_data->version < 2 || function_data->version > 3) {
+    if (function_data->version < 2 || function_data->version > FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4) {
         DEBUG_FUNCTION_LINE_ERR("Failed to patch function. struct version mismatch");
         return FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION;
     }
 
+    if (function_data->version == FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4 && (((function_replacement_data_v4_t *) function_data)->flags & ~FP_PATCH_FLAGS_SUPPORTED) != 0) {
+        // Don't silently ignore flags that are added in a later version.
+        DEBUG_FUNCTION_LINE_ERR("Failed to patch function. Unsupported flags: %08X", ((function_replacement_data_v4_t *) function_data)->flags);
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+
     std::optional<std::shared_ptr<PatchedFunctionData>> functionDataOpt;
     if (function_data->version == 2) {
-        functionDataOpt = PatchedFunctionData::make_shared_v2(gFunctionAddressProvider, (function_replacement_data_v2_t *) function_data, gJumpHeapHandle);
+        functionDataOpt = PatchedFunctionData::make_shared_v2(gFunctionAddressProvider, (function_replacement_data_v2_t *) function_data, &gTrampolineHeap);
     } else if (function_data->version == 3) {
-        functionDataOpt = PatchedFunctionData::make_shared_v3(gFunctionAddressProvider, (function_replacement_data_v3_t *) function_data, gJumpHeapHandle);
+        functionDataOpt = PatchedFunctionData::make_shared_v3(gFunctionAddressProvider, (function_replacement_data_v3_t *) function_data, &gTrampolineHeap);
+    } else if (function_data->version == FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4) {
+        functionDataOpt = PatchedFunctionData::make_shared_v4(gFunctionAddressProvider, (function_replacement_data_v4_t *) function_data, &gTrampolineHeap);
     } else {
         // Should never happen.
         DEBUG_FUNCTION_LINE_ERR("Unknown function_replacement_data_t struct version");
@@ -38,7 +56,21 @@ FunctionPatcherStatus FPAddFunctionPatch(function_replacement_data_t *function_d
         return FUNCTION_PATCHER_RESULT_UNKNOWN_ERROR;
     }
 
-    auto &functionData = functionDataOpt.value();
+    outFunctionData = std::move(functionDataOpt.value());
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+FunctionPatcherStatus FPAddFunctionPatch(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle, bool *outHasBeenPatched) {
+    std::shared_ptr<PatchedFunctionData> functionData;
+    auto res = CreatePatchedFunctionData(function_data, functionData);
+    if (res != FUNCTION_PATCHER_RESULT_SUCCESS) {
+        return res;
+    }
+
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    if (gPatchedFunctionHandles.add(functionData) == 0) {
+        return FUNCTION_PATCHER_RESULT_UNKNOWN_ERROR;
+    }
 
     // PatchFunction calls OSFatal on fatal errors.
     // If this function returns false the target function was not patched
@@ -52,68 +84,81 @@ FunctionPatcherStatus FPAddFunctionPatch(function_replacement_data_t *function_d
         *outHandle = functionData->getHandle();
     }
 
-    {
-        std::lock_guard lock(gPatchedFunctionsMutex);
-        gPatchedFunctions.push_back(std::move(functionData));
+    gTitlePatches.add(functionData);
+    gPatchedFunctions.push_back(std::move(functionData));
 
-        OSMemoryBarrier();
-    }
+    OSMemoryBarrier();
 
     return FUNCTION_PATCHER_RESULT_SUCCESS;
 }
 
-bool FunctionPatcherPatchFunction(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle) {
-    return FPAddFunctionPatch(function_data, outHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS;
-}
+FunctionPatcherStatus FPAddFunctionPatches(function_replacement_data_t **function_data, uint32_t count, PatchedFunctionHandle *outHandles, FunctionPatcherStatus *outStatuses) {
+    if (function_data == nullptr || count == 0) {
+        DEBUG_FUNCTION_LINE_ERR("function_data was NULL or empty");
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
 
-FunctionPatcherStatus FPRemoveFunctionPatch(PatchedFunctionHandle handle) {
     std::lock_guard lock(gPatchedFunctionsMutex);
-    std::vector<std::shared_ptr<PatchedFunctionData>> toBeTempRestored;
-    bool found            = false;
-    int32_t erasePosition = 0;
-    std::shared_ptr<PatchedFunctionData> toBeRemoved;
-    for (auto &cur : gPatchedFunctions) {
-        if (cur->getHandle() == handle) {
-            toBeRemoved = cur;
-            found       = true;
-            if (!cur->isPatched) {
-                // Early return if the function is not patched.
-                break;
-            }
-            continue;
+    FunctionPatcherStatus result = FUNCTION_PATCHER_RESULT_SUCCESS;
+    std::vector<std::shared_ptr<PatchedFunctionData>> functionDataList;
+    functionDataList.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::shared_ptr<PatchedFunctionData> functionData;
+        auto res = CreatePatchedFunctionData(function_data[i], functionData);
+        if (res == FUNCTION_PATCHER_RESULT_SUCCESS && gPatchedFunctionHandles.add(functionData) == 0) {
+            res = FUNCTION_PATCHER_RESULT_UNKNOWN_ERROR;
+        }
+        if (outStatuses) {
+            outStatuses[i] = res;
         }
-        // Check if something else patched the same function afterwards.
-        if (found) {
-            if (cur->realPhysicalFunctionAddress == toBeRemoved->realPhysicalFunctionAddress) {
-                toBeTempRestored.push_back(cur);
+        if (outHandles) {
+            outHandles[i] = res == FUNCTION_PATCHER_RESULT_SUCCESS ? functionData->getHandle() : 0;
+        }
+        if (res != FUNCTION_PATCHER_RESULT_SUCCESS) {
+            // Report the first error, but still add all valid patches.
+            if (result == FUNCTION_PATCHER_RESULT_SUCCESS) {
+                result = res;
             }
-        } else {
-            erasePosition++;
+            continue;
         }
+        functionDataList.push_back(std::move(functionData));
     }
-    if (!found) {
-        DEBUG_FUNCTION_LINE_ERR("Failed to find PatchedFunctionData by handle %08X", handle);
-        return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
+
+    // Functions that could not be patched yet (e.g. because the target RPL is not loaded) will be patched later.
+    PatchFunctions(functionDataList);
+
+    for (auto &cur : functionDataList) {
+        gTitlePatches.add(cur);
+        gPatchedFunctions.push_back(std::move(cur));
     }
 
-    if (toBeRemoved->isPatched) {
-        // Restore function patches that were done after the patch we actually want to restore.
-        for (auto &cur : std::ranges::reverse_view(toBeTempRestored)) {
-            RestoreFunction(cur);
-        }
+    OSMemoryBarrier();
 
-        // Restore the function we actually want to restore
-        RestoreFunction(toBeRemoved);
+    return result;
+}
+
+bool FunctionPatcherPatchFunction(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle) {
+    return FPAddFunctionPatch(function_data, outHandle, nullptr) == FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+FunctionPatcherStatus FPRemoveFunctionPatch(PatchedFunctionHandle handle) {
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    auto toBeRemoved = gPatchedFunctionHandles.get(handle);
+    if (!toBeRemoved) {
+        DEBUG_FUNCTION_LINE_ERR("Failed to find PatchedFunctionData by handle %08X", handle);
+        return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
     }
 
-    gPatchedFunctions.erase(gPatchedFunctions.begin() + erasePosition);
+    UnpatchFunction(toBeRemoved);
 
-    if (toBeRemoved->isPatched) {
-        // Apply the other patches again
-        for (auto &cur : toBeTempRestored) {
-            PatchFunction(cur);
-        }
+    gPendingPatches.remove(toBeRemoved);
+    gTitlePatches.remove(toBeRemoved);
+
+    auto pos = std::find(gPatchedFunctions.begin(), gPatchedFunctions.end(), toBeRemoved);
+    if (pos != gPatchedFunctions.end()) {
+        gPatchedFunctions.erase(pos);
     }
+    gPatchedFunctionHandles.remove(handle);
 
     OSMemoryBarrier();
     return FUNCTION_PATCHER_RESULT_SUCCESS;
@@ -127,7 +172,84 @@ FunctionPatcherStatus FPGetVersion(FunctionPatcherAPIVersion *outVersion) {
     if (outVersion == nullptr) {
         return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
     }
-    *outVersion = 2;
+    *outVersion = 7;
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+FunctionPatcherStatus FPGetJumpHeapStats(FunctionPatcherJumpHeapStats *outStats) {
+    if (outStats == nullptr) {
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+    if (outStats->version != FUNCTION_PATCHER_JUMP_HEAP_STATS_VERSION) {
+        return FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION;
+    }
+    auto stats                  = gTrampolineHeap.getStats();
+    outStats->arenaCount        = stats.arenaCount;
+    outStats->bytesTotal        = stats.bytesTotal;
+    outStats->bytesInUse        = stats.bytesInUse;
+    outStats->bytesInUsePeak    = stats.bytesInUsePeak;
+    outStats->failedAllocations = stats.failedAllocations;
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+static void CopyTiming(const PatchStatistics::Timing &timing, FunctionPatcherTiming *out) {
+    out->ticks    = timing.ticks;
+    out->count    = timing.count;
+    out->reserved = 0;
+}
+
+FunctionPatcherStatus FPGetStatistics(FunctionPatcherStatistics *outStatistics) {
+    if (outStatistics == nullptr) {
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+    if (outStatistics->version != FUNCTION_PATCHER_STATISTICS_VERSION) {
+        return FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION;
+    }
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    outStatistics->reserved = 0;
+    CopyTiming(gPatchStatistics.get(PatchStatistics::SHOULD_BE_PATCHED), &outStatistics->shouldBePatched);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::UPDATE_FUNCTION_ADDRESSES), &outStatistics->updateFunctionAddresses);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::READ_INSTRUCTION), &outStatistics->readInstruction);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::GENERATE_TRAMPOLINES), &outStatistics->generateTrampolines);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::WRITE_ON_ALL_CORES), &outStatistics->writeOnAllCores);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::RESTORE_FUNCTION), &outStatistics->restoreFunction);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::NOTIFY_CALLBACK), &outStatistics->notifyCallback);
+    CopyTiming(gPatchStatistics.get(PatchStatistics::CHECK_IF_STILL_IN_MEMORY), &outStatistics->checkIfStillInMemory);
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+FunctionPatcherStatus FPGetFunctionPatchStatistics(PatchedFunctionHandle handle, FunctionPatcherPatchStatistics *outStatistics) {
+    if (outStatistics == nullptr) {
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+    if (outStatistics->version != FUNCTION_PATCHER_STATISTICS_VERSION) {
+        return FUNCTION_PATCHER_RESULT_UNSUPPORTED_STRUCT_VERSION;
+    }
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    auto patchedFunction = gPatchedFunctionHandles.get(handle);
+    if (!patchedFunction) {
+        return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
+    }
+    outStatistics->reserved = 0;
+    CopyTiming(patchedFunction->patchTiming, &outStatistics->patch);
+    CopyTiming(patchedFunction->restoreTiming, &outStatistics->restore);
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
+}
+
+FunctionPatcherStatus FPGetFunctionPatchCallCount(PatchedFunctionHandle handle, uint32_t *outCallCount) {
+    if (outCallCount == nullptr) {
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    auto patchedFunction = gPatchedFunctionHandles.get(handle);
+    if (!patchedFunction) {
+        return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
+    }
+    if (!patchedFunction->callCounter) {
+        DEBUG_FUNCTION_LINE_ERR("Patch %08X was added without FP_PATCH_FLAG_COUNT_CALLS", handle);
+        return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
+    }
+    *outCallCount = patchedFunction->callCounter->sum();
     return FUNCTION_PATCHER_RESULT_SUCCESS;
 }
 
@@ -136,16 +258,20 @@ FunctionPatcherStatus FPIsFunctionPatched(PatchedFunctionHandle handle, bool *ou
         return FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT;
     }
     std::lock_guard lock(gPatchedFunctionsMutex);
-    for (auto &cur : gPatchedFunctions) {
-        if (cur->getHandle() == handle) {
-            *outIsFunctionPatched = cur->isPatched;
-            return FUNCTION_PATCHER_RESULT_SUCCESS;
-        }
+    auto patchedFunction = gPatchedFunctionHandles.get(handle);
+    if (!patchedFunction) {
+        return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
     }
-    return FUNCTION_PATCHER_RESULT_PATCH_NOT_FOUND;
+    *outIsFunctionPatched = patchedFunction->isPatched;
+    return FUNCTION_PATCHER_RESULT_SUCCESS;
 }
 
 WUMS_EXPORT_FUNCTION(FPGetVersion);
 WUMS_EXPORT_FUNCTION(FPAddFunctionPatch);
+WUMS_EXPORT_FUNCTION(FPAddFunctionPatches);
 WUMS_EXPORT_FUNCTION(FPRemoveFunctionPatch);
-WUMS_EXPORT_FUNCTION(FPIsFunctionPatched);
\ No newline at end of file
+WUMS_EXPORT_FUNCTION(FPIsFunctionPatched);
+WUMS_EXPORT_FUNCTION(FPGetJumpHeapStats);
+WUMS_EXPORT_FUNCTION(FPGetStatistics);
+WUMS_EXPORT_FUNCTION(FPGetFunctionPatchStatistics);
+WUMS_EXPORT_FUNCTION(FPGetFunctionPatchCallCount);
\ No newline at end of file
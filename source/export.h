@@ -1,6 +1,23 @@
 #pragma once
+#include "fpatching_defines_ext.h"
 #include <function_patcher/fpatching_defines.h>
 
 bool FunctionPatcherPatchFunction(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle);
 
-bool FunctionPatcherRestoreFunction(PatchedFunctionHandle handle);
\ No newline at end of file
+bool FunctionPatcherRestoreFunction(PatchedFunctionHandle handle);
+
+FunctionPatcherStatus FPAddFunctionPatch(function_replacement_data_t *function_data, PatchedFunctionHandle *outHandle, bool *outHasBeenPatched);
+
+FunctionPatcherStatus FPAddFunctionPatches(function_replacement_data_t **function_data, uint32_t count, PatchedFunctionHandle *outHandles, FunctionPatcherStatus *outStatuses);
+
+FunctionPatcherStatus FPRemoveFunctionPatch(PatchedFunctionHandle handle);
+
+FunctionPatcherStatus FPIsFunctionPatched(PatchedFunctionHandle handle, bool *outIsFunctionPatched);
+
+FunctionPatcherStatus FPGetJumpHeapStats(FunctionPatcherJumpHeapStats *outStats);
+
+FunctionPatcherStatus FPGetStatistics(FunctionPatcherStatistics *outStatistics);
+
+FunctionPatcherStatus FPGetFunctionPatchStatistics(PatchedFunctionHandle handle, FunctionPatcherPatchStatistics *outStatistics);
+
+FunctionPatcherStatus FPGetFunctionPatchCallCount(PatchedFunctionHandle handle, uint32_t *outCallCount);
\ No newline at end of file
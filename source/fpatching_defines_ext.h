@@ -0,0 +1,94 @@
+#pragma once
+
+/* Types of API additions that are not part of libfunctionpatcher (yet). */
+
+#include <function_patcher/fpatching_defines.h>
+#include <stdint.h>
+
+#define FUNCTION_PATCHER_JUMP_HEAP_STATS_VERSION 1
+#define FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4 4
+
+typedef enum FunctionPatcherPatchFlags {
+    FP_PATCH_FLAG_NONE               = 0,
+    FP_PATCH_FLAG_COUNT_CALLS        = 1 << 0, /* Count the calls of the replacement, see FPGetFunctionPatchCallCount */
+    /* Decide once per application (Wii U Menu or game) instead of on every call whether the replacement is called.
+     * Calls from background processes behave like calls from the application. Always used for patches of executables.
+     * Requires FPGetVersion >= 7, older versions ignore it. */
+    FP_PATCH_FLAG_SPECIALISE_PROCESS = 1 << 1,
+} FunctionPatcherPatchFlags;
+
+/* Flags this version knows, a patch with any other flag is rejected with FUNCTION_PATCHER_RESULT_INVALID_ARGUMENT. */
+#define FP_PATCH_FLAGS_SUPPORTED (FP_PATCH_FLAG_COUNT_CALLS | FP_PATCH_FLAG_SPECIALISE_PROCESS)
+
+/* Same layout as function_replacement_data_v3_t, extended by flags. */
+typedef struct function_replacement_data_v4_t {
+    uint32_t version; /* [needs to be filled] FUNCTION_REPLACEMENT_DATA_STRUCT_VERSION_V4 */
+    FunctionPatcherFunctionType type;
+    uint32_t physicalAddr;
+    uint32_t virtualAddr;
+    uint32_t replaceAddr;
+    uint32_t *replaceCall;
+    FunctionPatcherTargetProcess targetProcess;
+    union {
+        struct {
+            function_replacement_library_type_t library;
+            const char *function_name;
+        } ReplaceInRPL;
+        struct {
+            const uint64_t *targetTitleIds;
+            uint32_t targetTitleIdsCount;
+            uint16_t versionMin;
+            uint16_t versionMax;
+            const char *executableName;
+            union {
+                uint32_t textOffset;
+                const char *functionName;
+            };
+        } ReplaceInRPX;
+    };
+    uint32_t flags; /* [needs to be filled] FunctionPatcherPatchFlags */
+} function_replacement_data_v4_t;
+
+typedef struct FunctionPatcherJumpHeapStats {
+    uint32_t version;           /* [needs to be filled] FUNCTION_PATCHER_JUMP_HEAP_STATS_VERSION */
+    uint32_t arenaCount;        /* [will be filled] Number of memory areas the trampolines are allocated from */
+    uint32_t bytesTotal;        /* [will be filled] Size of all arenas */
+    uint32_t bytesInUse;        /* [will be filled] Memory used by the trampolines of all patches */
+    uint32_t bytesInUsePeak;    /* [will be filled] Highest value of bytesInUse so far */
+    uint32_t failedAllocations; /* [will be filled] Number of trampolines that could not be allocated */
+} FunctionPatcherJumpHeapStats;
+
+
+#define FUNCTION_PATCHER_STATISTICS_VERSION 1
+
+typedef struct FunctionPatcherTiming {
+    uint64_t ticks; /* [will be filled] Accumulated time in OSTime ticks (see OSTicksToMicroseconds) */
+    uint32_t count; /* [will be filled] Number of measurements */
+    uint32_t reserved;
+} FunctionPatcherTiming;
+
+/*
+ * The phases are inclusive and nest, so they can't be summed up:
+ * - notifyCallback contains checkIfStillInMemory and every phase of the patches that are applied or restored by the notification.
+ * - restoreFunction contains the cross-core writes that are needed while restoring (counted in writeOnAllCores as well).
+ * shouldBePatched, updateFunctionAddresses, readInstruction, generateTrampolines and writeOnAllCores never overlap each other.
+ */
+typedef struct FunctionPatcherStatistics {
+    uint32_t version; /* [needs to be filled] FUNCTION_PATCHER_STATISTICS_VERSION */
+    uint32_t reserved;
+    FunctionPatcherTiming shouldBePatched;         /* [will be filled] Check if a patch applies to the current title */
+    FunctionPatcherTiming updateFunctionAddresses; /* [will be filled] Resolving the address of the patched functions */
+    FunctionPatcherTiming readInstruction;         /* [will be filled] Reading the instruction that gets replaced */
+    FunctionPatcherTiming generateTrampolines;     /* [will be filled] Allocating and generating the trampolines */
+    FunctionPatcherTiming writeOnAllCores;         /* [will be filled] Writing the patches and flushing the caches on all cores */
+    FunctionPatcherTiming restoreFunction;         /* [will be filled] Restoring patched functions */
+    FunctionPatcherTiming notifyCallback;          /* [will be filled] Handling RPL (un)load notifications */
+    FunctionPatcherTiming checkIfStillInMemory;    /* [will be filled] Checking if patched functions have been unloaded */
+} FunctionPatcherStatistics;
+
+typedef struct FunctionPatcherPatchStatistics {
+    uint32_t version; /* [needs to be filled] FUNCTION_PATCHER_STATISTICS_VERSION */
+    uint32_t reserved;
+    FunctionPatcherTiming patch;   /* [will be filled] Every attempt to apply the patch (one per count), including its share of the writes */
+    FunctionPatcherTiming restore; /* [will be filled] Every time the patch has been restored */
+} FunctionPatcherPatchStatistics;
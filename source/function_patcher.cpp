@@ -1,65 +1,106 @@
 #include "function_patcher.h"
 #include "FunctionAddressProvider.h"
 #include "PatchedFunctionData.h"
-#include "utils/CThread.h"
+#include "utils/CoreWorkerPool.h"
+#include "utils/CurrentTitle.h"
+#include "utils/Platform.h"
+#include "utils/globals.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 
-#include <coreinit/cache.h>
 #include <coreinit/debug.h>
-#include <coreinit/memorymap.h>
-
-#include <kernel/kernel.h>
+#include <coreinit/time.h>
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <ranges>
 
-static void writeDataAndFlushIC(CThread *thread, void *arg) {
-    (void) thread;
-    auto *data = (PatchedFunctionData *) arg;
-
-    uint32_t replace_instruction = data->replaceWithInstruction;
-    uint32_t physical_address    = data->realPhysicalFunctionAddress;
-    uint32_t effective_address   = data->realEffectiveFunctionAddress;
-    DCFlushRange(&replace_instruction, 4);
-    DCFlushRange(&physical_address, 4);
-
-    auto replace_instruction_physical = (uint32_t) &replace_instruction;
-
+static void writePatchedInstructionAndFlushIC(PatchedFunctionData *data) {
     if (data->jumpData) {
-        DCFlushRange(data->jumpData, data->jumpDataSize * sizeof(uint32_t));
-        ICInvalidateRange(data->jumpData, data->jumpDataSize * sizeof(uint32_t));
+        Platform::flushCode(data->jumpData, data->jumpDataSize * sizeof(uint32_t));
     }
     if (data->jumpToOriginal) {
-        DCFlushRange(data->jumpToOriginal, 5 * sizeof(uint32_t));
-        ICInvalidateRange(data->jumpToOriginal, 5 * sizeof(uint32_t));
+        Platform::flushCode(data->jumpToOriginal, data->jumpToOriginalSize * sizeof(uint32_t));
     }
     if (data->realCallFunctionAddressPtr) {
-        DCFlushRange(data->realCallFunctionAddressPtr, sizeof(uint32_t));
-        ICInvalidateRange(data->realCallFunctionAddressPtr, sizeof(uint32_t));
+        Platform::flushCode(data->realCallFunctionAddressPtr, sizeof(uint32_t));
     }
 
-    if (replace_instruction_physical < 0x00800000 || replace_instruction_physical >= 0x01000000) {
-        replace_instruction_physical = OSEffectiveToPhysical(replace_instruction_physical);
-    } else {
-        replace_instruction_physical = replace_instruction_physical + 0x30800000 - 0x00800000;
+    // While a dispatcher is active it owns the function entry, it starts calling the patch once it has been updated.
+    if (gProcessDispatchers.getEntryInstruction(data->realPhysicalFunctionAddress)) {
+        return;
     }
+    Platform::writePhysical(data->realPhysicalFunctionAddress, data->replaceWithInstruction);
+    Platform::invalidateInstructions((void *) (uintptr_t) data->realEffectiveFunctionAddress, 4);
+}
 
-    KernelCopyData(physical_address, replace_instruction_physical, 4);
-    ICInvalidateRange((void *) (effective_address), 4);
+static void writeDataAndFlushIC(void *arg) {
+    writePatchedInstructionAndFlushIC((PatchedFunctionData *) arg);
 }
 
-bool PatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
-    if (patchedFunction->isPatched) {
-        return true;
+static void writeBatchDataAndFlushIC(void *arg) {
+    auto *batch = (std::vector<std::shared_ptr<PatchedFunctionData>> *) arg;
+    // Keep the order, later patches for the same address have to win.
+    for (auto &cur : *batch) {
+        writePatchedInstructionAndFlushIC(cur.get());
     }
+}
 
-    if (!patchedFunction->shouldBePatched()) {
-        return false;
+static void flushTrampolinesAndInvalidateIC(void *arg) {
+    auto *data = (PatchedFunctionData *) arg;
+    if (data->jumpData) {
+        Platform::flushCode(data->jumpData, data->jumpDataSize * sizeof(uint32_t));
+    }
+    if (data->jumpToOriginal) {
+        Platform::flushCode(data->jumpToOriginal, data->jumpToOriginalSize * sizeof(uint32_t));
+    }
+}
+
+/**
+ * Merges the process filtered patches of the function into its dispatcher after the chain has changed.
+ * entryInstruction is the instruction the function entry needs if the patches can't be merged (anymore).
+ */
+static void UpdateDispatcher(uint32_t physicalAddress, uint32_t entryInstruction) {
+    gProcessDispatchers.update(physicalAddress, gPatchChains.get(physicalAddress), entryInstruction);
+}
+
+/**
+ * Checks if the patch applies to the current application, a patch that doesn't is not pending anymore.
+ */
+static bool ShouldBePatched(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    bool shouldBePatched;
+    {
+        ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::SHOULD_BE_PATCHED);
+        shouldBePatched = patchedFunction->shouldBePatched();
+    }
+    if (!shouldBePatched) {
+        // Nothing to wait for in this application.
+        gPendingPatches.remove(patchedFunction);
     }
+    return shouldBePatched;
+}
 
+/**
+ * Resolves the address of the function, saves the instruction that will be replaced and generates the trampolines.
+ * Nothing is written to the target function yet, the caller has to check ShouldBePatched() first.
+ *
+ * pendingInstructions contains instructions that will be written to a physical address as part of the same batch,
+ * these are used instead of the instruction that is currently in memory.
+ * resolvedAddress is the address of a by-name executable patch if it has already been looked up.
+ */
+static bool PrepareFunctionPatch(std::shared_ptr<PatchedFunctionData> &patchedFunction, const std::map<uint32_t, uint32_t> *pendingInstructions, std::optional<uint32_t> resolvedAddress) {
     // The addresses of a function might change every time with run another application.
-    if (!patchedFunction->updateFunctionAddresses()) {
+    bool addressesUpdated;
+    {
+        ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::UPDATE_FUNCTION_ADDRESSES);
+        addressesUpdated = patchedFunction->updateFunctionAddresses(resolvedAddress);
+    }
+    if (!addressesUpdated) {
+        // Usually this means the target RPL is not (yet) loaded, try again once it has been loaded.
+        gPendingPatches.add(patchedFunction);
         return false;
     }
 
@@ -69,9 +110,27 @@ bool PatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
         DEBUG_FUNCTION_LINE("Patching function @ %08X", patchedFunction->realEffectiveFunctionAddress);
     }
 
-    if (!ReadFromPhysicalAddress(patchedFunction->realPhysicalFunctionAddress, &patchedFunction->replacedInstruction)) {
-        DEBUG_FUNCTION_LINE_ERR("Failed to read instruction.");
-        OSFatal("FunctionPatcherModule: Failed to read instruction.");
+    auto *chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    if (pendingInstructions && pendingInstructions->contains(patchedFunction->realPhysicalFunctionAddress)) {
+        // Another patch of this batch replaces the same function, stack on top of it.
+        patchedFunction->replacedInstruction = pendingInstructions->at(patchedFunction->realPhysicalFunctionAddress);
+    } else if (chain && gProcessDispatchers.getEntryInstruction(patchedFunction->realPhysicalFunctionAddress)) {
+        // The function entry jumps to a dispatcher, the new patch is stacked on top of the newest patch of the chain.
+        patchedFunction->replacedInstruction = chain->back()->replaceWithInstruction;
+    } else {
+        ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::READ_INSTRUCTION);
+        if (!ReadFromPhysicalAddress(patchedFunction->realPhysicalFunctionAddress, &patchedFunction->replacedInstruction)) {
+            DEBUG_FUNCTION_LINE_ERR("Failed to read instruction.");
+            OSFatal("FunctionPatcherModule: Failed to read instruction.");
+            return false;
+        }
+    }
+
+    ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::GENERATE_TRAMPOLINES);
+
+    // Now that the address and the replaced instruction are known, only use as much memory for the trampolines as needed.
+    if (!patchedFunction->fitDataForJumps()) {
+        DEBUG_FUNCTION_LINE_ERR("Failed to allocate trampolines");
         return false;
     }
 
@@ -82,16 +141,142 @@ bool PatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
     // If the correct process calls this, it'll jump the function replacement, otherwise the original function will be called.
     patchedFunction->generateReplacementJump();
 
+    return true;
+}
+
+static bool ApplyFunctionPatch(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (!ShouldBePatched(patchedFunction) || !PrepareFunctionPatch(patchedFunction, nullptr, {})) {
+        return false;
+    }
+
     // Write this->replaceWithInstruction to the first instruction of the function we want to replace.
-    CThread::runOnAllCores(writeDataAndFlushIC, patchedFunction.get());
+    {
+        ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::WRITE_ON_ALL_CORES);
+        CoreWorkerPool::runOnAllCores(writeDataAndFlushIC, patchedFunction.get());
+    }
 
     // Set patch status
     patchedFunction->isPatched = true;
+    gPatchChains.add(patchedFunction);
+    gPendingPatches.remove(patchedFunction);
+
+    UpdateDispatcher(patchedFunction->realPhysicalFunctionAddress, patchedFunction->replaceWithInstruction);
 
     return true;
 }
 
-bool RestoreFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+bool PatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (patchedFunction->isPatched) {
+        return true;
+    }
+
+    // Every attempt is a single measurement of the patch, whether it has been applied or not.
+    auto start  = OSGetTime();
+    bool result = ApplyFunctionPatch(patchedFunction);
+    patchedFunction->patchTiming.add(OSGetTime() - start);
+    return result;
+}
+
+/**
+ * Resolves the exports of all by-name executable patches at once, so the single patches don't enter the kernel one by one.
+ * Returns the resolved address for every by-name executable patch (0 if it doesn't exist), nothing for the other patches.
+ */
+static std::vector<std::optional<uint32_t>> PrefetchExecutableExports(const std::vector<std::shared_ptr<PatchedFunctionData>> &patchedFunctions) {
+    std::vector<std::optional<uint32_t>> result(patchedFunctions.size());
+    std::vector<PlatformExportRequest> requests;
+    std::vector<uint32_t> requestIndices;
+    for (uint32_t i = 0; i < patchedFunctions.size(); i++) {
+        auto &cur = patchedFunctions[i];
+        if (cur->type != FUNCTION_PATCHER_REPLACE_FOR_EXECUTABLE_BY_NAME || !cur->executableName || !cur->functionName) {
+            continue;
+        }
+        requests.push_back({cur->executableName.value(), cur->functionName.value(), 0});
+        requestIndices.push_back(i);
+    }
+    if (requests.empty()) {
+        return result;
+    }
+    Platform::findExecutableExports(requests);
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        result[requestIndices[i]] = requests[i].address;
+    }
+    return result;
+}
+
+uint32_t PatchFunctions(std::vector<std::shared_ptr<PatchedFunctionData>> &patchedFunctions) {
+    // Every patch is checked once, only the ones for this application are resolved.
+    // Like in PatchFunction every attempt is a single measurement of the patch, the time is collected until it ends.
+    std::vector<std::shared_ptr<PatchedFunctionData>> toBePrepared;
+    std::vector<OSTime> preparedTicks;
+    toBePrepared.reserve(patchedFunctions.size());
+    preparedTicks.reserve(patchedFunctions.size());
+    for (auto &cur : patchedFunctions) {
+        if (cur->isPatched) {
+            continue;
+        }
+        auto start           = OSGetTime();
+        bool shouldBePatched = ShouldBePatched(cur);
+        auto duration        = OSGetTime() - start;
+        if (!shouldBePatched) {
+            cur->patchTiming.add(duration);
+            continue;
+        }
+        toBePrepared.push_back(cur);
+        preparedTicks.push_back(duration);
+    }
+    auto resolvedAddresses = PrefetchExecutableExports(toBePrepared);
+
+    std::vector<std::shared_ptr<PatchedFunctionData>> toBeWritten;
+    std::vector<OSTime> writtenTicks;
+    std::map<uint32_t, uint32_t> pendingInstructions;
+    toBeWritten.reserve(toBePrepared.size());
+    writtenTicks.reserve(toBePrepared.size());
+
+    for (uint32_t i = 0; i < toBePrepared.size(); i++) {
+        auto &cur = toBePrepared[i];
+        if (cur->isPatched) {
+            cur->patchTiming.add(preparedTicks[i]);
+            continue;
+        }
+        auto start    = OSGetTime();
+        bool prepared = PrepareFunctionPatch(cur, &pendingInstructions, resolvedAddresses[i]);
+        auto duration = preparedTicks[i] + OSGetTime() - start;
+        if (!prepared) {
+            cur->patchTiming.add(duration);
+            continue;
+        }
+        pendingInstructions[cur->realPhysicalFunctionAddress] = cur->replaceWithInstruction;
+        toBeWritten.push_back(cur);
+        writtenTicks.push_back(duration);
+    }
+
+    if (toBeWritten.empty()) {
+        return 0;
+    }
+
+    // Write all instructions and invalidate the caches with a single sync across all cores.
+    auto start = OSGetTime();
+    CoreWorkerPool::runOnAllCores(writeBatchDataAndFlushIC, &toBeWritten);
+    auto duration = OSGetTime() - start;
+    gPatchStatistics.add(PatchStatistics::WRITE_ON_ALL_CORES, duration);
+
+    for (uint32_t i = 0; i < toBeWritten.size(); i++) {
+        auto &cur = toBeWritten[i];
+        // Every patch of the batch pays the same share of the write.
+        cur->patchTiming.add(writtenTicks[i] + duration / (OSTime) toBeWritten.size());
+        cur->isPatched = true;
+        gPatchChains.add(cur);
+        gPendingPatches.remove(cur);
+    }
+
+    for (auto &[address, instruction] : pendingInstructions) {
+        UpdateDispatcher(address, instruction);
+    }
+
+    return toBeWritten.size();
+}
+
+static bool RestoreFunctionPhases(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
     if (!patchedFunction->isPatched) {
         DEBUG_FUNCTION_LINE_VERBOSE("Skip restoring function because it's not patched");
         return true;
@@ -104,7 +289,7 @@ bool RestoreFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
     auto targetAddrPhys = (uint32_t) patchedFunction->realPhysicalFunctionAddress;
 
     if (patchedFunction->library != LIBRARY_OTHER) {
-        targetAddrPhys = (uint32_t) OSEffectiveToPhysical(patchedFunction->realEffectiveFunctionAddress);
+        targetAddrPhys = Platform::effectiveToPhysical(patchedFunction->realEffectiveFunctionAddress);
     }
 
     // Check if patched instruction is still loaded.
@@ -114,29 +299,282 @@ bool RestoreFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
         return false;
     }
 
-    if (currentInstruction != patchedFunction->replaceWithInstruction) {
-        DEBUG_FUNCTION_LINE_WARN("Instruction is different than expected. Skip restoring. Expected: %08X Real: %08X", currentInstruction, patchedFunction->replaceWithInstruction);
+    // While a dispatcher is active the function entry jumps to it instead of the newest patch.
+    auto dispatcherEntry     = gProcessDispatchers.getEntryInstruction(patchedFunction->realPhysicalFunctionAddress);
+    auto expectedInstruction = dispatcherEntry.value_or(patchedFunction->replaceWithInstruction);
+    if (currentInstruction != expectedInstruction) {
+        DEBUG_FUNCTION_LINE_WARN("Instruction is different than expected. Skip restoring. Expected: %08X Real: %08X", expectedInstruction, currentInstruction);
         return false;
     }
 
-    DEBUG_FUNCTION_LINE_VERBOSE("Restoring %08X to %08X [%08X]", (uint32_t) patchedFunction->replacedInstruction, patchedFunction->realEffectiveFunctionAddress, targetAddrPhys);
-    auto sourceAddr = (uint32_t) &patchedFunction->replacedInstruction;
+    auto *chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    if (dispatcherEntry) {
+        if (!chain || chain->back() != patchedFunction) {
+            DEBUG_FUNCTION_LINE_WARN("Only the newest patch can be restored. Skip restoring.");
+            return false;
+        }
+        // The dispatcher stops calling the patch once it has been updated.
+    } else {
+        DEBUG_FUNCTION_LINE_VERBOSE("Restoring %08X to %08X [%08X]", (uint32_t) patchedFunction->replacedInstruction, patchedFunction->realEffectiveFunctionAddress, targetAddrPhys);
+        if (!Platform::writePhysical(targetAddrPhys, patchedFunction->replacedInstruction)) {
+            OSFatal("FunctionPatcherModule: Failed to get physical address");
+        }
+        Platform::invalidateInstructions((void *) (uintptr_t) patchedFunction->realEffectiveFunctionAddress, 4);
+        Platform::flushData((void *) (uintptr_t) patchedFunction->realEffectiveFunctionAddress, 4);
+    }
 
-    auto sourceAddrPhys = (uint32_t) OSEffectiveToPhysical(sourceAddr);
+    patchedFunction->isPatched = false;
+    gPatchChains.remove(patchedFunction);
 
-    // These hardcoded values should be replaced with something more dynamic.
-    if (sourceAddrPhys == 0 && (sourceAddr >= 0x00800000 && sourceAddr < 0x01000000)) {
-        sourceAddrPhys = sourceAddr + (0x30800000 - 0x00800000);
+    chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    UpdateDispatcher(patchedFunction->realPhysicalFunctionAddress, chain ? chain->back()->replaceWithInstruction : patchedFunction->replacedInstruction);
+    return true;
+}
+
+bool RestoreFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    auto start    = OSGetTime();
+    bool result   = RestoreFunctionPhases(patchedFunction);
+    auto duration = OSGetTime() - start;
+    gPatchStatistics.add(PatchStatistics::RESTORE_FUNCTION, duration);
+    patchedFunction->restoreTiming.add(duration);
+    return result;
+}
+
+void MarkFunctionAsUnpatched(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (!patchedFunction->isPatched) {
+        return;
     }
+    patchedFunction->isPatched = false;
+    gPatchChains.remove(patchedFunction);
+    // Patch it again once the code is back.
+    gPendingPatches.add(patchedFunction);
+}
 
-    if (sourceAddrPhys == 0) {
-        OSFatal("FunctionPatcherModule: Failed to get physical address");
+bool UnlinkFunctionPatch(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    if (!patchedFunction->isPatched) {
+        return true;
+    }
+    auto *chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    if (!chain) {
+        return false;
+    }
+    auto pos = std::find(chain->begin(), chain->end(), patchedFunction);
+    if (pos == chain->end()) {
+        return false;
     }
 
-    KernelCopyData(targetAddrPhys, sourceAddrPhys, 4);
-    ICInvalidateRange((void *) patchedFunction->realEffectiveFunctionAddress, 4);
-    DCFlushRange((void *) patchedFunction->realEffectiveFunctionAddress, 4);
+    if (pos + 1 == chain->end()) {
+        // The function entry jumps to this patch, write back the instruction it has replaced.
+        return RestoreFunction(patchedFunction);
+    }
 
-    patchedFunction->isPatched = false;
+    // The next patch of the chain jumps to this patch when calling the "original" function,
+    // let it execute the instruction this patch has replaced instead.
+    auto next = *(pos + 1);
+    if (next->replacedInstruction != patchedFunction->replaceWithInstruction) {
+        DEBUG_FUNCTION_LINE_WARN("Chain is inconsistent. Expected: %08X Real: %08X", patchedFunction->replaceWithInstruction, next->replacedInstruction);
+        return false;
+    }
+
+    // A dispatcher might jump into the trampolines of the next patch, let it follow the chain until they have been updated.
+    gProcessDispatchers.park(patchedFunction->realPhysicalFunctionAddress);
+
+    if (!next->updateReplacedInstruction(patchedFunction->replacedInstruction)) {
+        // E.g. a relative branch that needs a long jump once it's relocated.
+        DEBUG_FUNCTION_LINE_VERBOSE("Replaced instruction doesn't fit into the trampolines of the next patch");
+        UpdateDispatcher(patchedFunction->realPhysicalFunctionAddress, chain->back()->replaceWithInstruction);
+        return false;
+    }
+    {
+        ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::WRITE_ON_ALL_CORES);
+        CoreWorkerPool::runOnAllCores(flushTrampolinesAndInvalidateIC, next.get());
+    }
+
+    MarkFunctionAsUnpatched(patchedFunction);
+
+    // The next patch is still part of the chain.
+    chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    UpdateDispatcher(patchedFunction->realPhysicalFunctionAddress, chain->back()->replaceWithInstruction);
     return true;
 }
+
+void UnpatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction) {
+    // Usually only the neighbour in the chain has to be updated.
+    if (!patchedFunction->isPatched || UnlinkFunctionPatch(patchedFunction)) {
+        return;
+    }
+
+    DEBUG_FUNCTION_LINE_VERBOSE("Failed to unlink patch, restoring and re-applying the chain instead");
+    std::vector<std::shared_ptr<PatchedFunctionData>> toBeTempRestored;
+    // Check if something else patched the same function afterwards.
+    auto *chain = gPatchChains.get(patchedFunction->realPhysicalFunctionAddress);
+    if (chain) {
+        auto pos = std::find(chain->begin(), chain->end(), patchedFunction);
+        if (pos != chain->end()) {
+            toBeTempRestored.assign(pos + 1, chain->end());
+        }
+    }
+
+    // Restore function patches that were done after the patch we actually want to restore.
+    for (auto &cur : std::ranges::reverse_view(toBeTempRestored)) {
+        RestoreFunction(cur);
+    }
+
+    // Restore the function we actually want to restore
+    RestoreFunction(patchedFunction);
+    // Make sure the patch is not part of a chain anymore, even if restoring failed.
+    MarkFunctionAsUnpatched(patchedFunction);
+
+    // Apply the other patches again
+    for (auto &cur : toBeTempRestored) {
+        PatchFunction(cur);
+    }
+}
+
+uint32_t UnpatchProcessSpecialisedLibraryFunctions() {
+    std::vector<std::shared_ptr<PatchedFunctionData>> toBeRemoved;
+    for (auto &[address, chain] : gPatchChains.getChains()) {
+        for (auto &cur : chain) {
+            if (cur->isProcessSpecialised() && cur->type == FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS) {
+                toBeRemoved.push_back(cur);
+            }
+        }
+    }
+    // Remove the newest patches first, so the chains are unlinked from the top.
+    for (auto &cur : std::ranges::reverse_view(toBeRemoved)) {
+        UnpatchFunction(cur);
+        // It'll be considered again when the next application starts.
+        gPendingPatches.remove(cur);
+    }
+    return toBeRemoved.size();
+}
+
+/**
+ * Checks if the functions in [startAddress, endAddress) are still patched by comparing the instruction.
+ * Only the last patch of each chain is visible at the function entry, so only one read per function is needed.
+ */
+void CheckIfPatchedFunctionsAreStillInMemory(uint32_t startAddress, uint32_t endAddress) {
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::CHECK_IF_STILL_IN_MEMORY);
+    auto &chains = gPatchChains.getChains();
+    for (auto it = chains.begin(); it != chains.end();) {
+        auto &chain = it->second;
+        auto &last  = chain.back();
+        if (last->realEffectiveFunctionAddress < startAddress || last->realEffectiveFunctionAddress >= endAddress) {
+            ++it;
+            continue;
+        }
+
+        // Check if patched instruction is still loaded.
+        uint32_t currentInstruction;
+        if (!ReadFromPhysicalAddress(it->first, &currentInstruction)) {
+            DEBUG_FUNCTION_LINE_ERR("Failed to read instruction.");
+            ++it;
+            continue;
+        }
+
+        // A dispatcher replaces the instruction of the last patch.
+        if (currentInstruction == gProcessDispatchers.getEntryInstruction(it->first).value_or(last->replaceWithInstruction)) {
+            ++it;
+            continue;
+        }
+
+        // The function has been unloaded, this resets the whole chain.
+        gProcessDispatchers.drop(it->first);
+        for (auto &cur : chain) {
+            cur->isPatched = false;
+            gPendingPatches.add(cur);
+        }
+        it = chains.erase(it);
+    }
+}
+
+void CheckIfPatchedFunctionsAreStillInMemory() {
+    CheckIfPatchedFunctionsAreStillInMemory(0, 0xFFFFFFFF);
+}
+
+void OnRPLLoaded(const PlatformRPLInfo *rpl) {
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::NOTIFY_CALLBACK);
+    if (rpl) {
+        gLoadedRPLs.add(*rpl);
+    }
+    // Only retry the patches that are waiting for this module.
+    auto toBePatched = rpl && rpl->name ? gPendingPatches.takeForModule(rpl->name) : gPendingPatches.takeAll();
+    // Patches that still can't be applied are added to the pending patches again.
+    PatchFunctions(toBePatched);
+}
+
+void OnRPLUnloaded(PlatformModule module, const PlatformRPLInfo *rpl) {
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    ScopedPhaseTimer timer(gPatchStatistics, PatchStatistics::NOTIFY_CALLBACK);
+    auto library = gFunctionAddressProvider->getTypeForHandle(module);
+    if (library != LIBRARY_OTHER) {
+        // All patches of a chain replace the same function, if the library is gone the whole chain is gone.
+        auto &chains = gPatchChains.getChains();
+        for (auto it = chains.begin(); it != chains.end();) {
+            bool isInLibrary = std::ranges::any_of(it->second, [library](auto &cur) {
+                return cur->type == FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS && cur->library.has_value() && cur->library == library;
+            });
+            if (isInLibrary) {
+                gProcessDispatchers.drop(it->first);
+                for (auto &cur : it->second) {
+                    cur->isPatched = false;
+                    gPendingPatches.add(cur);
+                }
+                it = chains.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    gFunctionAddressProvider->resetHandle(module);
+    if (rpl && rpl->name) {
+        gLoadedRPLs.remove(rpl->name);
+        Platform::resetExecutableExports(rpl->name);
+    }
+    if (rpl) {
+        // Only the code of the unloaded module has changed.
+        CheckIfPatchedFunctionsAreStillInMemory(rpl->textAddr, rpl->textAddr + rpl->textSize);
+    } else {
+        CheckIfPatchedFunctionsAreStillInMemory();
+    }
+}
+
+void OnApplicationStarts() {
+    // The worker threads belong to the current process and are stopped in OnApplicationEnds.
+    if (!CoreWorkerPool::start()) {
+        DEBUG_FUNCTION_LINE_WARN("Failed to start core worker threads, falling back to temporary threads");
+    }
+
+    // The title can't change while the application is running, resolve it once instead of for every patch.
+    CurrentTitle::update();
+
+    std::lock_guard lock(gPatchedFunctionsMutex);
+    // reset function patch status if the rpl they were patching has been unloaded from memory.
+    CheckIfPatchedFunctionsAreStillInMemory();
+    gLoadedRPLs.refresh();
+    DEBUG_FUNCTION_LINE_VERBOSE("Patch all functions");
+    // Patches for other titles would be skipped anyway.
+    auto toBePatched = gTitlePatches.getForTitle(CurrentTitle::getTitleId().value());
+    PatchFunctions(toBePatched);
+}
+
+void OnApplicationEnds() {
+    {
+        std::lock_guard lock(gPatchedFunctionsMutex);
+        // The startup code of the next process must not run into a replacement that has been specialised for this one.
+        uint32_t removed = UnpatchProcessSpecialisedLibraryFunctions();
+        if (removed > 0) {
+            DEBUG_FUNCTION_LINE_VERBOSE("Removed %d process specialised patches", removed);
+        }
+    }
+    CoreWorkerPool::stop();
+    gFunctionAddressProvider->resetHandles();
+    Platform::resetAllExecutableExports();
+    CurrentTitle::reset();
+    {
+        std::lock_guard lock(gPatchedFunctionsMutex);
+        gLoadedRPLs.reset();
+    }
+}
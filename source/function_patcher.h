@@ -1,7 +1,7 @@
 #pragma once
 
 #include "PatchedFunctionData.h"
-#include <coreinit/dynload.h>
+#include "utils/Platform.h"
 #include <function_patcher/fpatching_defines.h>
 #include <memory>
 #include <vector>
@@ -13,6 +13,64 @@ extern "C" {
 bool PatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction);
 bool RestoreFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction);
 
+/**
+ * Resets the patch status without touching the memory, e.g. because the patched code has been unloaded.
+ * The patch will be applied again once the target is loaded.
+ */
+void MarkFunctionAsUnpatched(std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+/**
+ * Removes a patch from its chain by rewriting the instruction of the next patch (or the function entry if it's the last patch).
+ * The other patches of the chain stay untouched. Returns false if the patch could not be unlinked.
+ */
+bool UnlinkFunctionPatch(std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+/**
+ * Removes a patch from memory. If it can't be unlinked, the patches on top of it are restored and applied again.
+ * The patch is added to the pending patches, the caller has to remove it if it shouldn't be applied again.
+ */
+void UnpatchFunction(std::shared_ptr<PatchedFunctionData> &patchedFunction);
+
+/**
+ * Removes the process specialised patches of libraries, they jump to their replacement in any process.
+ * Has to be called before another process starts, the patches are applied again if they target the next application.
+ * Returns the number of removed patches.
+ */
+uint32_t UnpatchProcessSpecialisedLibraryFunctions();
+
+/**
+ * Patches all given functions with a single cross-core sync.
+ * Returns the number of functions that have been patched by this call, use isPatched to check the individual results.
+ */
+uint32_t PatchFunctions(std::vector<std::shared_ptr<PatchedFunctionData>> &patchedFunctions);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
+
+/**
+ * Resets the patch status of all patches whose function entry in [startAddress, endAddress) doesn't contain the patched instruction anymore.
+ */
+void CheckIfPatchedFunctionsAreStillInMemory(uint32_t startAddress, uint32_t endAddress);
+
+void CheckIfPatchedFunctionsAreStillInMemory();
+
+/**
+ * Applies the pending patches of a loaded RPL, or all pending patches if rpl is nullptr.
+ */
+void OnRPLLoaded(const PlatformRPLInfo *rpl);
+
+/**
+ * Resets the patches of an unloaded RPL, they are applied again once it has been loaded again.
+ */
+void OnRPLUnloaded(PlatformModule module, const PlatformRPLInfo *rpl);
+
+/**
+ * Applies the patches for the application that is starting in the current process.
+ */
+void OnApplicationStarts();
+
+/**
+ * Removes what only applies to the application that is ending and forgets the modules it has loaded.
+ */
+void OnApplicationEnds();
@@ -1,16 +1,19 @@
+#include "Benchmark.h"
 #include "FunctionAddressProvider.h"
 #include "export.h"
 #include "function_patcher.h"
+#include "main.h"
+#include "utils/Platform.h"
 #include "utils/globals.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 
+#include <algorithm>
+#include <coreinit/cache.h>
 #include <coreinit/memdefaultheap.h>
-#include <coreinit/memexpheap.h>
+#include <coreinit/memorymap.h>
 #include <kernel/kernel.h>
 #include <mutex>
-#include <ranges>
-#include <set>
 #include <wums.h>
 
 WUMS_MODULE_EXPORT_NAME("homebrew_functionpatcher");
@@ -42,37 +45,6 @@ void UpdateFunctionPointer() {
     OSDynLoad_Release(coreinitModule);
 }
 
-void CheckIfPatchedFunctionsAreStillInMemory() {
-    std::lock_guard lock(gPatchedFunctionsMutex);
-    // Check if rpl has been unloaded by comparing the instruction.
-    std::set<uint32_t> physicalAddressesUnchanged;
-    std::set<uint32_t> physicalAddressesChanged;
-    // Restore function patches that were done after the patch we actually want to restore.
-    for (auto &cur : std::ranges::reverse_view(gPatchedFunctions)) {
-        if (!cur->isPatched || physicalAddressesUnchanged.contains(cur->realPhysicalFunctionAddress)) {
-            continue;
-        }
-        if (physicalAddressesChanged.contains(cur->realPhysicalFunctionAddress)) {
-            cur->isPatched = false;
-            continue;
-        }
-
-        // Check if patched instruction is still loaded.
-        uint32_t currentInstruction;
-        if (!ReadFromPhysicalAddress(cur->realPhysicalFunctionAddress, &currentInstruction)) {
-            DEBUG_FUNCTION_LINE_ERR("Failed to read instruction.");
-            continue;
-        }
-
-        if (currentInstruction == cur->replaceWithInstruction) {
-            physicalAddressesUnchanged.insert(cur->realPhysicalFunctionAddress);
-        } else {
-            cur->isPatched = false;
-            physicalAddressesChanged.insert(cur->realPhysicalFunctionAddress);
-        }
-    }
-}
-
 bool PatchInstruction(void *instr, uint32_t original, uint32_t replacement) {
     uint32_t current = *(uint32_t *) instr;
     if (current != original) {
@@ -113,13 +85,12 @@ WUMS_INITIALIZE() {
     }
 
     memset(gJumpHeapData, 0, JUMP_HEAP_DATA_SIZE);
-    gJumpHeapHandle = MEMCreateExpHeapEx((void *) (gJumpHeapData), JUMP_HEAP_DATA_SIZE, 1);
-    if (gJumpHeapHandle == nullptr) {
+    if (!gTrampolineHeap.addArena(gJumpHeapData, JUMP_HEAP_DATA_SIZE)) {
         DEBUG_FUNCTION_LINE_ERR("Failed to create heap for jump data");
         OSFatal("FunctionPatcherModule: Failed to create heap for jump data");
     }
 
-    gFunctionAddressProvider = make_shared_nothrow<FunctionAddressProvider>();
+    gFunctionAddressProvider = make_shared_nothrow<FunctionAddressProvider>(&gLoadedRPLs);
     if (!gFunctionAddressProvider) {
         DEBUG_FUNCTION_LINE_ERR("Failed to create gFunctionAddressProvider");
         OSFatal("FunctionPatcherModule: Failed to create gFunctionAddressProvider");
@@ -131,24 +102,14 @@ void notify_callback(OSDynLoad_Module module,
                      OSDynLoad_NotifyReason reason,
                      OSDynLoad_NotifyData *infos) {
     (void) userContext;
-    (void) infos;
+    PlatformRPLInfo rpl = {};
+    if (infos) {
+        rpl = {infos->name, infos->textAddr, infos->textSize};
+    }
     if (reason == OS_DYNLOAD_NOTIFY_LOADED) {
-        std::lock_guard lock(gPatchedFunctionsMutex);
-        for (auto &cur : gPatchedFunctions) {
-            PatchFunction(cur);
-        }
+        OnRPLLoaded(infos ? &rpl : nullptr);
     } else if (reason == OS_DYNLOAD_NOTIFY_UNLOADED) {
-        std::lock_guard lock(gPatchedFunctionsMutex);
-        auto library = gFunctionAddressProvider->getTypeForHandle(module);
-        if (library != LIBRARY_OTHER) {
-            for (auto &cur : gPatchedFunctions) {
-                if (cur->type == FUNCTION_PATCHER_REPLACE_BY_LIB_OR_ADDRESS && cur->library.has_value() && cur->library == library) {
-                    cur->isPatched = false;
-                }
-            }
-        }
-        gFunctionAddressProvider->resetHandle(module);
-        CheckIfPatchedFunctionsAreStillInMemory();
+        OnRPLUnloaded(module, infos ? &rpl : nullptr);
     }
 }
 
@@ -165,25 +126,29 @@ WUMS_APPLICATION_STARTS() {
     gMEMFreeToDefaultHeapForThreads      = MEMFreeToDefaultHeap;
 
     initLogging();
+
+    OnApplicationStarts();
+
     {
         std::lock_guard lock(gPatchedFunctionsMutex);
-        // reset function patch status if the rpl they were patching has been unloaded from memory.
-        CheckIfPatchedFunctionsAreStillInMemory();
-        DEBUG_FUNCTION_LINE_VERBOSE("Patch all functions");
-        for (auto &cur : gPatchedFunctions) {
-            PatchFunction(cur);
-        }
-
         OSMemoryBarrier();
         OSDynLoad_AddNotifyCallback(notify_callback, nullptr);
     }
+
+#ifdef BENCHMARK
+    static bool benchmarkDone = false;
+    if (!benchmarkDone) {
+        benchmarkDone = true;
+        Benchmark::run();
+    }
+#endif
 }
 
 WUMS_APPLICATION_REQUESTS_EXIT() {
     deinitLogging();
 }
 WUMS_APPLICATION_ENDS() {
-    gFunctionAddressProvider->resetHandles();
+    OnApplicationEnds();
 }
 
 WUMS_EXPORT_FUNCTION(FunctionPatcherPatchFunction);
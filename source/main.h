@@ -0,0 +1,9 @@
+#pragma once
+
+#include <coreinit/dynload.h>
+#include <cstdint>
+
+void notify_callback(OSDynLoad_Module module,
+                     void *userContext,
+                     OSDynLoad_NotifyReason reason,
+                     OSDynLoad_NotifyData *infos);
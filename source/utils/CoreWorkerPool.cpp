@@ -0,0 +1,120 @@
+#include "CoreWorkerPool.h"
+#include "CThread.h"
+#include "logger.h"
+
+#include <coreinit/messagequeue.h>
+#include <coreinit/semaphore.h>
+#include <coreinit/thread.h>
+#include <cstring>
+#include <mutex>
+
+#define CORE_WORKER_COUNT      3
+#define CORE_WORKER_STACK_SIZE 0x4000
+
+typedef struct CoreWorker {
+    OSThread thread;
+    OSMessageQueue queue;
+    OSMessage messages[1];
+} CoreWorker;
+
+// Don't use the default heap, some games (e.g. Minecraft) expect it to be empty.
+static CoreWorker sCoreWorkers[CORE_WORKER_COUNT] __attribute__((section(".data"), aligned(0x20)));
+static uint8_t sCoreWorkerStacks[CORE_WORKER_COUNT][CORE_WORKER_STACK_SIZE] __attribute__((section(".data"), aligned(0x20)));
+static OSSemaphore sCoreWorkersDoneSemaphore __attribute__((section(".data")));
+static bool sCoreWorkersRunning __attribute__((section(".data")));
+static std::mutex sCoreWorkersMutex;
+
+typedef struct CoreWorkerFallbackArgs {
+    CoreWorkerPool::Callback callback;
+    void *arg;
+} CoreWorkerFallbackArgs;
+
+static void CoreWorkerFallback(CThread *thread, void *arg) {
+    (void) thread;
+    auto *args = (CoreWorkerFallbackArgs *) arg;
+    args->callback(args->arg);
+}
+
+static int32_t CoreWorkerThreadEntry(int32_t argc, const char **argv) {
+    (void) argc;
+    auto *worker = (CoreWorker *) argv;
+    while (true) {
+        OSMessage message;
+        OSReceiveMessage(&worker->queue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+        auto callback = (CoreWorkerPool::Callback) message.message;
+        if (callback == nullptr) {
+            // Request to shut down the worker.
+            break;
+        }
+        callback((void *) message.args[0]);
+        OSSignalSemaphore(&sCoreWorkersDoneSemaphore);
+    }
+    return 0;
+}
+
+bool CoreWorkerPool::start() {
+    std::lock_guard lock(sCoreWorkersMutex);
+    if (sCoreWorkersRunning) {
+        return true;
+    }
+    OSInitSemaphore(&sCoreWorkersDoneSemaphore, 0);
+
+    int32_t aff[] = {CThread::eAttributeAffCore0, CThread::eAttributeAffCore1, CThread::eAttributeAffCore2};
+    for (int i = 0; i < CORE_WORKER_COUNT; i++) {
+        auto &worker = sCoreWorkers[i];
+        memset(&worker, 0, sizeof(worker));
+        OSInitMessageQueue(&worker.queue, worker.messages, sizeof(worker.messages) / sizeof(worker.messages[0]));
+        if (!OSCreateThread(&worker.thread, (OSThreadEntryPointFn) CoreWorkerThreadEntry, i, (char *) &worker,
+                            (void *) (sCoreWorkerStacks[i] + CORE_WORKER_STACK_SIZE), CORE_WORKER_STACK_SIZE, 16, aff[i])) {
+            DEBUG_FUNCTION_LINE_ERR("Failed to create worker thread for core %d", i);
+            // Stop the threads we already created.
+            for (int j = 0; j < i; j++) {
+                OSMessage message = {};
+                OSSendMessage(&sCoreWorkers[j].queue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+                OSJoinThread(&sCoreWorkers[j].thread, nullptr);
+            }
+            return false;
+        }
+        OSSetThreadName(&worker.thread, "FunctionPatcherModule CoreWorker");
+        OSResumeThread(&worker.thread);
+    }
+    sCoreWorkersRunning = true;
+    return true;
+}
+
+void CoreWorkerPool::stop() {
+    std::lock_guard lock(sCoreWorkersMutex);
+    if (!sCoreWorkersRunning) {
+        return;
+    }
+    for (auto &worker : sCoreWorkers) {
+        OSMessage message = {};
+        OSSendMessage(&worker.queue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+        OSJoinThread(&worker.thread, nullptr);
+    }
+    sCoreWorkersRunning = false;
+}
+
+bool CoreWorkerPool::isRunning() {
+    return sCoreWorkersRunning;
+}
+
+void CoreWorkerPool::runOnAllCores(Callback callback, void *arg) {
+    std::lock_guard lock(sCoreWorkersMutex);
+    if (!sCoreWorkersRunning) {
+        CoreWorkerFallbackArgs fallbackArgs = {callback, arg};
+        CThread::runOnAllCores(CoreWorkerFallback, &fallbackArgs);
+        return;
+    }
+
+    // Same order as CThread::runOnAllCores, wait for each core before moving on to the next one.
+    for (int i = CORE_WORKER_COUNT - 1; i >= 0; i--) {
+        OSMessage message;
+        message.message = (void *) callback;
+        message.args[0] = (uint32_t) arg;
+        message.args[1] = 0;
+        message.args[2] = 0;
+        OSSendMessage(&sCoreWorkers[i].queue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+        OSWaitSemaphore(&sCoreWorkersDoneSemaphore);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Long-lived worker threads, one pinned to each core.
+ *
+ * The threads are created once per application and sleep until a job is posted, this avoids allocating
+ * (and freeing) a thread and its stack on the default heap for every write that needs to be done on all cores.
+ * If the pool is not running, runOnAllCores falls back to CThread::runOnAllCores.
+ */
+class CoreWorkerPool {
+public:
+    typedef void (*Callback)(void *arg);
+
+    static bool start();
+
+    static void stop();
+
+    static bool isRunning();
+
+    /**
+     * Runs the callback on every core (one after another) and returns once every core has finished it.
+     */
+    static void runOnAllCores(Callback callback, void *arg);
+};
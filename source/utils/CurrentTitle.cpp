@@ -0,0 +1,43 @@
+#include "CurrentTitle.h"
+#include "Platform.h"
+#include "logger.h"
+#include <cinttypes>
+#include <mutex>
+
+static std::mutex sCurrentTitleMutex;
+static std::optional<uint64_t> sTitleId;
+static std::optional<uint16_t> sTitleVersion;
+static std::optional<uint32_t> sProcessId;
+
+void CurrentTitle::update() {
+    std::lock_guard lock(sCurrentTitleMutex);
+    sTitleId      = Platform::getTitleId();
+    sTitleVersion = Platform::getTitleVersion(sTitleId.value());
+    sProcessId    = Platform::getUPID();
+
+    if (!sTitleVersion) {
+        DEBUG_FUNCTION_LINE_VERBOSE("Failed to get title version of %016" PRIX64 ".", sTitleId.value());
+    }
+}
+
+void CurrentTitle::reset() {
+    std::lock_guard lock(sCurrentTitleMutex);
+    sTitleId      = {};
+    sTitleVersion = {};
+    sProcessId    = {};
+}
+
+std::optional<uint64_t> CurrentTitle::getTitleId() {
+    std::lock_guard lock(sCurrentTitleMutex);
+    return sTitleId;
+}
+
+std::optional<uint16_t> CurrentTitle::getTitleVersion() {
+    std::lock_guard lock(sCurrentTitleMutex);
+    return sTitleVersion;
+}
+
+std::optional<uint32_t> CurrentTitle::getProcessId() {
+    std::lock_guard lock(sCurrentTitleMutex);
+    return sProcessId;
+}
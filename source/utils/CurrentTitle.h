@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+/**
+ * Title ID, version and process (UPID) of the running application.
+ *
+ * All are resolved once in WUMS_APPLICATION_STARTS (update) so filtering patches by title doesn't need any IOS calls.
+ * Until then and after WUMS_APPLICATION_ENDS (reset) they are unknown, the getters never resolve them on their own
+ * because they can be called from any process.
+ */
+class CurrentTitle {
+public:
+    static void update();
+
+    static void reset();
+
+    /**
+     * Returns the title ID of the application, or an empty optional if no application is running.
+     */
+    static std::optional<uint64_t> getTitleId();
+
+    /**
+     * Returns the version of the application, or an empty optional if no application is running or
+     * the version couldn't be determined.
+     */
+    static std::optional<uint16_t> getTitleVersion();
+
+    /**
+     * Returns the UPID of the application (Wii U Menu or game), or an empty optional if no application is running.
+     */
+    static std::optional<uint32_t> getProcessId();
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Hash index of the function symbols of the .text section of an (big-endian) ELF/RPL.
+ *
+ * The parsing doesn't depend on any Cafe OS function and reads all fields byte-wise as big-endian,
+ * so it can be used on the console (from kernel mode) and on a host system against .rpx/.rpl files.
+ *
+ * The sections are accessed via a Sections type that has to provide:
+ *   uint32_t count() const;                          // number of section headers
+ *   uint32_t stringTableIndex() const;               // index of the section name string table (shstrndx)
+ *   const uint8_t *header(uint32_t index) const;     // raw section header
+ *   const uint8_t *data(uint32_t index) const;       // (uncompressed) section data, nullptr if not available
+ */
+class ElfSymbolIndex {
+public:
+    typedef struct Entry {
+        uint32_t hashHigh;
+        uint32_t hashLow;
+        uint32_t nameOffset; // into the names the index has been filled with
+        uint32_t value;      // 0 marks an empty slot
+    } Entry;
+
+    static constexpr uint64_t hashName(std::string_view name) {
+        // FNV-1a
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (char c : name) {
+            hash ^= (uint8_t) c;
+            hash *= 0x00000100000001B3ULL;
+        }
+        return hash;
+    }
+
+    static constexpr uint32_t capacityForSymbols(uint32_t numSymbols) {
+        // Keep the load factor at about 2/3
+        return numSymbols + numSymbols / 2 + 1;
+    }
+
+    template<typename Sections>
+    static uint32_t countFunctionSymbols(const Sections &sections) {
+        uint32_t result = 0;
+        forEachFunctionSymbol(sections, [&result](const char *, uint32_t) { result++; });
+        return result;
+    }
+
+    /**
+     * Size of the buffer fill() copies the names of the function symbols to, including the null terminators.
+     */
+    template<typename Sections>
+    static uint32_t countFunctionSymbolNameBytes(const Sections &sections) {
+        uint32_t result = 0;
+        forEachFunctionSymbol(sections, [&result](const char *name, uint32_t) { result += std::string_view(name).size() + 1; });
+        return result;
+    }
+
+    /**
+     * Fills entries (capacity has to be at least capacityForSymbols(countFunctionSymbols(sections))) and copies the names
+     * to names (namesCapacity has to be at least countFunctionSymbolNameBytes(sections)), so lookups can compare the name
+     * without access to the string table of the ELF. If a name exists multiple times, the first symbol wins.
+     */
+    template<typename Sections>
+    static bool fill(const Sections &sections, Entry *entries, uint32_t capacity, char *names, uint32_t namesCapacity) {
+        if (!entries || capacity == 0 || !names) {
+            return false;
+        }
+        for (uint32_t i = 0; i < capacity; i++) {
+            entries[i] = {};
+        }
+        bool result        = true;
+        uint32_t namesSize = 0;
+        forEachFunctionSymbol(sections, [entries, capacity, names, namesCapacity, &namesSize, &result](const char *name, uint32_t value) {
+            if (value == 0) {
+                return;
+            }
+            std::string_view nameView = name;
+            auto hash                 = hashName(nameView);
+            auto hashHigh             = (uint32_t) (hash >> 32);
+            auto hashLow              = (uint32_t) hash;
+            for (uint32_t probe = 0; probe < capacity; probe++) {
+                auto &entry = entries[(hashLow + probe) % capacity];
+                if (entry.value == 0) {
+                    if (namesSize + nameView.size() + 1 > namesCapacity) {
+                        result = false;
+                        return;
+                    }
+                    nameView.copy(names + namesSize, nameView.size());
+                    names[namesSize + nameView.size()] = '\0';
+                    entry                              = {hashHigh, hashLow, namesSize, value};
+                    namesSize += nameView.size() + 1;
+                    return;
+                }
+                if (entry.hashHigh == hashHigh && entry.hashLow == hashLow && nameView == names + entry.nameOffset) {
+                    return;
+                }
+            }
+            result = false;
+        });
+        return result;
+    }
+
+    /**
+     * Returns the value of the symbol with the given name, or 0 if it's not part of the index.
+     * names has to be the buffer the index has been filled with.
+     */
+    static uint32_t find(const Entry *entries, uint32_t capacity, const char *names, std::string_view name) {
+        if (!entries || capacity == 0 || !names) {
+            return 0;
+        }
+        auto hash     = hashName(name);
+        auto hashHigh = (uint32_t) (hash >> 32);
+        auto hashLow  = (uint32_t) hash;
+        for (uint32_t probe = 0; probe < capacity; probe++) {
+            auto &entry = entries[(hashLow + probe) % capacity];
+            if (entry.value == 0) {
+                return 0;
+            }
+            // Different names can have the same hash.
+            if (entry.hashHigh == hashHigh && entry.hashLow == hashLow && name == names + entry.nameOffset) {
+                return entry.value;
+            }
+        }
+        return 0;
+    }
+
+private:
+    static constexpr uint32_t SHT_SYMTAB_TYPE = 2;
+    static constexpr uint32_t STT_FUNC_TYPE   = 2;
+    static constexpr uint32_t SYMBOL_SIZE     = 0x10;
+
+    static uint32_t readBE32(const uint8_t *data) {
+        return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 8) | (uint32_t) data[3];
+    }
+
+    static uint16_t readBE16(const uint8_t *data) {
+        return (uint16_t) (((uint32_t) data[0] << 8) | (uint32_t) data[1]);
+    }
+
+    template<typename Sections>
+    static uint32_t findTextSection(const Sections &sections) {
+        auto shStrTab = sections.stringTableIndex() ? sections.data(sections.stringTableIndex()) : nullptr;
+        if (!shStrTab) {
+            return 0xFFFFFFFF;
+        }
+        uint32_t result = 0xFFFFFFFF;
+        for (uint32_t i = 0; i < sections.count(); i++) {
+            if (!sections.data(i)) {
+                continue;
+            }
+            // Section name (index into string table) is at offset 0x00
+            if (std::string_view((const char *) shStrTab + readBE32(sections.header(i))) == ".text") {
+                result = i;
+            }
+        }
+        return result;
+    }
+
+    template<typename Sections, typename Callback>
+    static void forEachFunctionSymbol(const Sections &sections, Callback callback) {
+        auto textSectionIndex = findTextSection(sections);
+        if (textSectionIndex == 0xFFFFFFFF) {
+            return;
+        }
+        for (uint32_t i = 0; i < sections.count(); i++) {
+            auto sectionData = sections.data(i);
+            if (!sectionData) {
+                continue;
+            }
+            auto sectionHeader = sections.header(i);
+            if (readBE32(sectionHeader + 0x04) != SHT_SYMTAB_TYPE) {
+                continue;
+            }
+            auto strTab = (const char *) sections.data(readBE32(sectionHeader + 0x18));
+            if (!strTab) {
+                continue;
+            }
+            auto entSize    = readBE32(sectionHeader + 0x24) ? readBE32(sectionHeader + 0x24) : SYMBOL_SIZE;
+            auto numSymbols = readBE32(sectionHeader + 0x14) / entSize;
+            for (uint32_t j = 0; j < numSymbols; j++) {
+                auto symbol = sectionData + j * entSize;
+                // name @ 0x00, value @ 0x04, info @ 0x0C, shndx @ 0x0E
+                if (readBE16(symbol + 0x0E) == textSectionIndex && (symbol[0x0C] & 0xF) == STT_FUNC_TYPE) {
+                    callback(strTab + readBE32(symbol), readBE32(symbol + 0x04));
+                }
+            }
+        }
+    }
+};
@@ -1,8 +1,15 @@
 #include "KernelFindExport.h"
+#include "ElfSymbolIndex.h"
+#include "logger.h"
 #include <coreinit/cache.h>
 #include <elf.h>
 #include <kernel/kernel.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <vector>
 
 #define KernelGetLoadedRPL ((LOADED_RPL * (*) (uint32_t))(0xfff13524))
 #define KernelGetRAMPID    ((int32_t(*)(uint32_t *))(0xfff10ea0))
@@ -81,14 +88,229 @@ uint32_t FindExportKernel(const char *rplName, const char *functionName) {
     return result;
 }
 
-extern "C" uint32_t SC_0x51(const char *rplname, const char *functionName);
+typedef struct LoadedRPLSections {
+    LOADED_RPL *rpl;
+
+    [[nodiscard]] uint32_t count() const {
+        return rpl->elfHeader.shnum;
+    }
+
+    [[nodiscard]] uint32_t stringTableIndex() const {
+        return rpl->elfHeader.shstrndx;
+    }
+
+    [[nodiscard]] const uint8_t *header(uint32_t index) const {
+        return ((const uint8_t *) rpl->sectionHeaderBuffer) + rpl->elfHeader.shentsize * index;
+    }
+
+    [[nodiscard]] const uint8_t *data(uint32_t index) const {
+        return (const uint8_t *) rpl->sectionAddressBuffer[index];
+    }
+} LoadedRPLSections;
+
+typedef struct SymbolIndexBuildRequest {
+    const char *rplName; // without extension, nullptr to skip this request
+    ElfSymbolIndex::Entry *entries;
+    uint32_t capacity;
+    char *names;
+    uint32_t namesCapacity;
+    uint32_t numSymbols;
+    uint32_t numNameBytes;
+} SymbolIndexBuildRequest;
+
+/*
+ * Counts the function symbols (and the size of their names) of each requested rpl and fills its index if entries and names are big enough.
+ * numSymbols stays 0 if the rpl is not loaded.
+ * All requests are handled with a single address space switch.
+ */
+void BuildSymbolIndicesKernel(SymbolIndexBuildRequest *requests, uint32_t count) {
+    if (requests == nullptr || count == 0) {
+        return;
+    }
+    uint32_t currentRamPID;
+    auto err = KernelGetRAMPID(&currentRamPID);
+    if (err != -1) {
+        // Switch to loader address space view.
+        KernelSetRAMPID(err, 2);
+        for (auto rpl = KernelGetLoadedRPL(0); rpl != nullptr; rpl = rpl->nextLoadedRpl) {
+            std::string_view moduleName(rpl->moduleNameBuffer);
+            for (uint32_t i = 0; i < count; i++) {
+                auto &request = requests[i];
+                if (request.rplName == nullptr || moduleName != request.rplName) {
+                    continue;
+                }
+                LoadedRPLSections sections = {rpl};
+                request.numSymbols         = ElfSymbolIndex::countFunctionSymbols(sections);
+                request.numNameBytes       = ElfSymbolIndex::countFunctionSymbolNameBytes(sections);
+                if (request.entries != nullptr && request.capacity >= ElfSymbolIndex::capacityForSymbols(request.numSymbols) &&
+                    request.names != nullptr && request.namesCapacity >= request.numNameBytes) {
+                    if (!ElfSymbolIndex::fill(sections, request.entries, request.capacity, request.names, request.namesCapacity)) {
+                        request.numSymbols = 0;
+                    }
+                }
+            }
+        }
+        // Switch back to "old" space address view
+        KernelSetRAMPID(err, currentRamPID);
+    }
+}
+
+extern "C" uint32_t SC_0x51(uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+typedef struct SymbolIndex {
+    std::unique_ptr<ElfSymbolIndex::Entry[]> entries;
+    uint32_t capacity;
+    // Copy of the names of the function symbols, the string table of the rpl is only accessible from the loader address space.
+    std::unique_ptr<char[]> names;
+} SymbolIndex;
+
+// Symbol index per rpl (without extension), kept until the rpl is unloaded.
+static std::map<std::string, SymbolIndex, std::less<>> sSymbolIndices;
+static std::mutex sSymbolIndicesMutex;
+
+static std::string_view StripRPLExtension(std::string_view rplName) {
+    if (rplName.ends_with(".rpx") || rplName.ends_with(".rpl")) {
+        rplName.remove_suffix(4);
+    }
+    return rplName;
+}
+
+/*
+ * Builds the indices of all given rpls. The syscall is patched once, the symbol tables are first counted
+ * and then filled after the memory has been allocated, so this costs two kernel calls no matter how many rpls are requested.
+ * Rpls that are not loaded are skipped.
+ */
+static void BuildSymbolIndices(const std::vector<std::string> &pureRPLNames) {
+    if (pureRPLNames.empty()) {
+        return;
+    }
+    std::vector<SymbolIndexBuildRequest> requests;
+    requests.reserve(pureRPLNames.size());
+    for (auto &rplName : pureRPLNames) {
+        requests.push_back({rplName.c_str(), nullptr, 0, nullptr, 0, 0, 0});
+    }
+
+    KernelPatchSyscall(0x51, (uint32_t) &BuildSymbolIndicesKernel);
+    OSMemoryBarrier();
+    SC_0x51((uint32_t) requests.data(), requests.size(), 0);
+
+    std::vector<std::unique_ptr<ElfSymbolIndex::Entry[]>> buffers(requests.size());
+    std::vector<std::unique_ptr<char[]>> nameBuffers(requests.size());
+    bool fillRequired = false;
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        auto &request = requests[i];
+        if (request.numSymbols == 0) {
+            // Either not loaded (yet) or no symbols, try again next time.
+            request.rplName = nullptr;
+            continue;
+        }
+        auto capacity = ElfSymbolIndex::capacityForSymbols(request.numSymbols);
+        buffers[i]     = std::unique_ptr<ElfSymbolIndex::Entry[]>(new (std::nothrow) ElfSymbolIndex::Entry[capacity]);
+        nameBuffers[i] = std::unique_ptr<char[]>(new (std::nothrow) char[request.numNameBytes]);
+        if (!buffers[i] || !nameBuffers[i]) {
+            DEBUG_FUNCTION_LINE_WARN("Failed to allocate symbol index for %s (%d symbols)", request.rplName, request.numSymbols);
+            request.rplName = nullptr;
+            continue;
+        }
+        request.entries       = buffers[i].get();
+        request.capacity      = capacity;
+        request.names         = nameBuffers[i].get();
+        request.namesCapacity = request.numNameBytes;
+        fillRequired          = true;
+    }
+
+    if (!fillRequired) {
+        return;
+    }
+
+    SC_0x51((uint32_t) requests.data(), requests.size(), 0);
+
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        auto &request = requests[i];
+        if (request.rplName == nullptr) {
+            continue;
+        }
+        if (request.numSymbols == 0) {
+            DEBUG_FUNCTION_LINE_WARN("Failed to build symbol index for %s", request.rplName);
+            continue;
+        }
+        sSymbolIndices.emplace(pureRPLNames[i], SymbolIndex{std::move(buffers[i]), request.capacity, std::move(nameBuffers[i])});
+    }
+}
+
+static uint32_t FindInSymbolIndex(const SymbolIndex &index, const std::string_view &functionName) {
+    return ElfSymbolIndex::find(index.entries.get(), index.capacity, index.names.get(), functionName);
+}
 
 uint32_t KernelFindExport(const std::string_view &rplName, const std::string_view &functionName) {
+    auto pureRPLName = std::string(StripRPLExtension(rplName));
+
+    std::lock_guard lock(sSymbolIndicesMutex);
+    auto it = sSymbolIndices.find(pureRPLName);
+    if (it == sSymbolIndices.end()) {
+        BuildSymbolIndices({pureRPLName});
+        it = sSymbolIndices.find(pureRPLName);
+    }
+    if (it != sSymbolIndices.end()) {
+        return FindInSymbolIndex(it->second, functionName);
+    }
+
+    // Fall back to searching the symbol table directly.
     KernelPatchSyscall(0x51, (uint32_t) &FindExportKernel);
     OSMemoryBarrier();
-    if (rplName.ends_with(".rpx") || rplName.ends_with(".rpl")) {
-        auto pureRPLName = std::string(rplName).substr(0, rplName.length() - 4);
-        return SC_0x51(pureRPLName.c_str(), functionName.data());
+    return SC_0x51((uint32_t) pureRPLName.c_str(), (uint32_t) functionName.data(), 0);
+}
+
+void KernelFindExports(std::span<PlatformExportRequest> requests) {
+    std::vector<std::string> pureRPLNames;
+    pureRPLNames.reserve(requests.size());
+    for (auto &request : requests) {
+        pureRPLNames.emplace_back(StripRPLExtension(request.rplName));
+    }
+
+    std::lock_guard lock(sSymbolIndicesMutex);
+
+    // Build all missing indices at once.
+    std::vector<std::string> missingIndices;
+    for (auto &rplName : pureRPLNames) {
+        if (!sSymbolIndices.contains(rplName) && std::find(missingIndices.begin(), missingIndices.end(), rplName) == missingIndices.end()) {
+            missingIndices.push_back(rplName);
+        }
+    }
+    BuildSymbolIndices(missingIndices);
+
+    bool fallbackPatched = false;
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        auto &request = requests[i];
+        if (auto it = sSymbolIndices.find(pureRPLNames[i]); it != sSymbolIndices.end()) {
+            request.address = FindInSymbolIndex(it->second, request.functionName);
+            continue;
+        }
+        // Fall back to searching the symbol table directly.
+        if (!fallbackPatched) {
+            KernelPatchSyscall(0x51, (uint32_t) &FindExportKernel);
+            OSMemoryBarrier();
+            fallbackPatched = true;
+        }
+        request.address = SC_0x51((uint32_t) pureRPLNames[i].c_str(), (uint32_t) request.functionName.data(), 0);
+    }
+}
+
+void KernelFindExportResetIndex(std::string_view moduleName) {
+    auto pureModuleName = StripRPLExtension(moduleName);
+
+    std::lock_guard lock(sSymbolIndicesMutex);
+    for (auto it = sSymbolIndices.begin(); it != sSymbolIndices.end();) {
+        // The module name might contain a path.
+        if (pureModuleName.ends_with(it->first)) {
+            it = sSymbolIndices.erase(it);
+        } else {
+            ++it;
+        }
     }
-    return SC_0x51(rplName.data(), functionName.data());
-}
\ No newline at end of file
+}
+
+void KernelFindExportResetIndices() {
+    std::lock_guard lock(sSymbolIndicesMutex);
+    sSymbolIndices.clear();
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "Platform.h"
 #include <cstdint>
+#include <span>
 #include <string>
 #include <wut.h>
 
@@ -148,4 +150,17 @@ WUT_CHECK_OFFSET(LOADED_RPL, 0xF4, sectionAddressBuffer);
 WUT_CHECK_OFFSET(LOADED_RPL, 0x114, nextLoadedRpl);
 WUT_CHECK_SIZE(LOADED_RPL, 0x118);
 
-uint32_t KernelFindExport(const std::string_view &rplName, const std::string_view &functioName);
\ No newline at end of file
+uint32_t KernelFindExport(const std::string_view &rplName, const std::string_view &functioName);
+
+/**
+ * Resolves many exports at once. The symbol tables of all rpls that haven't been indexed yet are read
+ * with a constant number of kernel calls instead of one call per function.
+ */
+void KernelFindExports(std::span<PlatformExportRequest> requests);
+
+/**
+ * Drops the symbol index of an unloaded rpl/rpx, it's rebuilt on the next lookup.
+ */
+void KernelFindExportResetIndex(std::string_view moduleName);
+
+void KernelFindExportResetIndices();
\ No newline at end of file
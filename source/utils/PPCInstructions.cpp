@@ -0,0 +1,9 @@
+#include "PPCInstructions.h"
+#include "logger.h"
+#include <coreinit/debug.h>
+
+void PPCInstructions::encodingError(const char *message) {
+    DEBUG_FUNCTION_LINE_ERR("Failed to encode instruction: %s", message);
+    OSFatal("FunctionPatcherModule: Failed to encode instruction");
+    while (true) {}
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Encoder for the PowerPC instructions used by the trampolines.
+ *
+ * All functions are constexpr. Operands that don't fit into the instruction call encodingError(), which
+ * makes the expression non-constant (compile error in constant expressions) and calls OSFatal at runtime.
+ * Callers that pick an encoding at runtime have to check the range first (see isInBranchRange etc.).
+ */
+class PPCInstructions {
+public:
+    enum Register : uint32_t {
+        R0  = 0,
+        R1  = 1,
+        R3  = 3,
+        R11 = 11,
+        R12 = 12,
+    };
+
+    enum ConditionRegisterField : uint32_t {
+        CR0 = 0,
+    };
+
+    enum SpecialPurposeRegister : uint32_t {
+        CTR  = 9,
+        UPIR = 1007, // ID of the current core
+    };
+
+    // Instructions without operands.
+    static constexpr uint32_t BCTR  = 0x4e800420;
+    static constexpr uint32_t BCTRL = 0x4e800421;
+    static constexpr uint32_t BLR   = 0x4e800020;
+    static constexpr uint32_t NOP   = 0x60000000;
+
+    static constexpr bool isInBranchRange(int32_t offset) {
+        return (offset & 3) == 0 && offset >= -0x02000000 && offset <= 0x01FFFFFC;
+    }
+
+    static constexpr bool isInAbsoluteBranchRange(uint32_t target) {
+        return (target & 0x01FFFFFC) == target;
+    }
+
+    static constexpr bool isInConditionalBranchRange(int32_t offset) {
+        return (offset & 3) == 0 && offset >= -0x8000 && offset <= 0x7FFC;
+    }
+
+    static constexpr bool isSignedImmediate(int32_t value) {
+        return value >= -0x8000 && value <= 0x7FFF;
+    }
+
+    static constexpr bool isUnsignedImmediate(uint32_t value) {
+        return value <= 0xFFFF;
+    }
+
+    /**
+     * Upper half of an address for "lis rA, high; lwz/stw rD, low(rA)", adjusted for the sign of the lower half.
+     */
+    static constexpr uint32_t getAddressHigh(uint32_t address) {
+        return ((address + 0x8000) >> 16) & 0xFFFF;
+    }
+
+    static constexpr int32_t getAddressLow(uint32_t address) {
+        return (int16_t) (address & 0xFFFF);
+    }
+
+    /**
+     * b/bl offset (relative to the address of the branch itself)
+     */
+    static constexpr uint32_t b(int32_t offset, bool link = false) {
+        if (!isInBranchRange(offset)) {
+            encodingError("b: offset out of range");
+        }
+        return (18u << 26) | ((uint32_t) offset & 0x03FFFFFC) | (link ? 1 : 0);
+    }
+
+    static constexpr uint32_t bl(int32_t offset) {
+        return b(offset, true);
+    }
+
+    /**
+     * ba/bla target
+     */
+    static constexpr uint32_t ba(uint32_t target, bool link = false) {
+        if (!isInAbsoluteBranchRange(target)) {
+            encodingError("ba: target out of range");
+        }
+        return (18u << 26) | target | 2 | (link ? 1 : 0);
+    }
+
+    /**
+     * bc BO, BI, offset (relative)
+     */
+    static constexpr uint32_t bc(uint32_t bo, uint32_t bi, int32_t offset) {
+        if (bo > 31 || bi > 31 || !isInConditionalBranchRange(offset)) {
+            encodingError("bc: operand out of range");
+        }
+        return (16u << 26) | (bo << 21) | (bi << 16) | ((uint32_t) offset & 0xFFFC);
+    }
+
+    /**
+     * beq offset, uses cr0
+     */
+    static constexpr uint32_t beq(int32_t offset) {
+        return bc(12, 2, offset);
+    }
+
+    /**
+     * addis rD, rA, value (rA = R0 means 0)
+     */
+    static constexpr uint32_t addis(Register rD, Register rA, uint32_t value) {
+        if (!isUnsignedImmediate(value)) {
+            encodingError("addis: immediate out of range");
+        }
+        return (15u << 26) | ((uint32_t) rD << 21) | ((uint32_t) rA << 16) | value;
+    }
+
+    /**
+     * lis rD, value (addis rD, 0, value)
+     */
+    static constexpr uint32_t lis(Register rD, uint32_t value) {
+        if (!isUnsignedImmediate(value)) {
+            encodingError("lis: immediate out of range");
+        }
+        return (15u << 26) | ((uint32_t) rD << 21) | value;
+    }
+
+    /**
+     * addi rD, rA, value (rA = R0 means 0)
+     */
+    static constexpr uint32_t addi(Register rD, Register rA, int32_t value) {
+        if (!isSignedImmediate(value)) {
+            encodingError("addi: immediate out of range");
+        }
+        return (14u << 26) | ((uint32_t) rD << 21) | ((uint32_t) rA << 16) | ((uint32_t) value & 0xFFFF);
+    }
+
+    /**
+     * add rD, rA, rB
+     */
+    static constexpr uint32_t add(Register rD, Register rA, Register rB) {
+        return (31u << 26) | ((uint32_t) rD << 21) | ((uint32_t) rA << 16) | ((uint32_t) rB << 11) | (266u << 1);
+    }
+
+    /**
+     * ori rA, rS, value
+     */
+    static constexpr uint32_t ori(Register rA, Register rS, uint32_t value) {
+        if (!isUnsignedImmediate(value)) {
+            encodingError("ori: immediate out of range");
+        }
+        return (24u << 26) | ((uint32_t) rS << 21) | ((uint32_t) rA << 16) | value;
+    }
+
+    /**
+     * lwz rD, offset(rA)
+     */
+    static constexpr uint32_t lwz(Register rD, int32_t offset, Register rA) {
+        if (!isSignedImmediate(offset)) {
+            encodingError("lwz: offset out of range");
+        }
+        return (32u << 26) | ((uint32_t) rD << 21) | ((uint32_t) rA << 16) | ((uint32_t) offset & 0xFFFF);
+    }
+
+    /**
+     * stw rS, offset(rA)
+     */
+    static constexpr uint32_t stw(Register rS, int32_t offset, Register rA) {
+        if (!isSignedImmediate(offset)) {
+            encodingError("stw: offset out of range");
+        }
+        return (36u << 26) | ((uint32_t) rS << 21) | ((uint32_t) rA << 16) | ((uint32_t) offset & 0xFFFF);
+    }
+
+    /**
+     * cmpwi crfD, rA, value
+     */
+    static constexpr uint32_t cmpwi(ConditionRegisterField crfD, Register rA, int32_t value) {
+        if (!isSignedImmediate(value)) {
+            encodingError("cmpwi: immediate out of range");
+        }
+        return (11u << 26) | ((uint32_t) crfD << 23) | ((uint32_t) rA << 16) | ((uint32_t) value & 0xFFFF);
+    }
+
+    /**
+     * rlwinm rA, rS, shift, maskBegin, maskEnd
+     */
+    static constexpr uint32_t rlwinm(Register rA, Register rS, uint32_t shift, uint32_t maskBegin, uint32_t maskEnd) {
+        if (shift > 31 || maskBegin > 31 || maskEnd > 31) {
+            encodingError("rlwinm: operand out of range");
+        }
+        return (21u << 26) | ((uint32_t) rS << 21) | ((uint32_t) rA << 16) | (shift << 11) | (maskBegin << 6) | (maskEnd << 1);
+    }
+
+    /**
+     * slwi rA, rS, shift (rlwinm rA, rS, shift, 0, 31 - shift)
+     */
+    static constexpr uint32_t slwi(Register rA, Register rS, uint32_t shift) {
+        if (shift > 31) {
+            encodingError("slwi: shift out of range");
+        }
+        return rlwinm(rA, rS, shift, 0, 31 - shift);
+    }
+
+    /**
+     * mfspr rD, spr
+     */
+    static constexpr uint32_t mfspr(Register rD, SpecialPurposeRegister spr) {
+        return (31u << 26) | ((uint32_t) rD << 21) | (encodeSPR(spr) << 11) | (339u << 1);
+    }
+
+    /**
+     * mtspr spr, rS
+     */
+    static constexpr uint32_t mtspr(SpecialPurposeRegister spr, Register rS) {
+        return (31u << 26) | ((uint32_t) rS << 21) | (encodeSPR(spr) << 11) | (467u << 1);
+    }
+
+    /**
+     * mtctr rS (mtspr 9, rS)
+     */
+    static constexpr uint32_t mtctr(Register rS) {
+        return mtspr(CTR, rS);
+    }
+
+    /**
+     * True for b, ba, bl and bla.
+     */
+    static constexpr bool isUnconditionalBranch(uint32_t instruction) {
+        return (instruction & 0xFC000000) == (18u << 26);
+    }
+
+    static constexpr bool isLink(uint32_t instruction) {
+        return (instruction & 1) == 1;
+    }
+
+    /**
+     * Returns the target of an unconditional branch located at the given address.
+     */
+    static constexpr uint32_t getBranchTarget(uint32_t instruction, uint32_t address) {
+        uint32_t target = instruction & 0x03FFFFFC;
+        if (target & 0x02000000) {
+            target |= 0xFC000000;
+        }
+        if ((instruction & 2) == 0) {
+            target += address;
+        }
+        return target;
+    }
+
+    [[noreturn]] static void encodingError(const char *message);
+
+private:
+    // The two 5 bit halves of the SPR number are swapped in the instruction.
+    static constexpr uint32_t encodeSPR(SpecialPurposeRegister spr) {
+        return (((uint32_t) spr & 0x1F) << 5) | (((uint32_t) spr >> 5) & 0x1F);
+    }
+};
+
+// Encodings that are checked against the hand-assembled instructions.
+static_assert(PPCInstructions::lis(PPCInstructions::R11, 0x1234) == 0x3d601234);
+static_assert(PPCInstructions::ori(PPCInstructions::R11, PPCInstructions::R11, 0x5678) == 0x616b5678);
+static_assert(PPCInstructions::lwz(PPCInstructions::R11, 0x10, PPCInstructions::R11) == 0x816b0010);
+static_assert(PPCInstructions::addi(PPCInstructions::R12, PPCInstructions::R12, 1) == 0x398c0001);
+static_assert(PPCInstructions::add(PPCInstructions::R12, PPCInstructions::R12, PPCInstructions::R11) == 0x7d8c5a14);
+static_assert(PPCInstructions::stw(PPCInstructions::R12, -0x10, PPCInstructions::R11) == 0x918bfff0);
+static_assert(PPCInstructions::getAddressHigh(0x1004EDCC) == 0x1005 && PPCInstructions::getAddressLow(0x1004EDCC) == -0x1234);
+static_assert(PPCInstructions::cmpwi(PPCInstructions::CR0, PPCInstructions::R11, 15) == 0x2c0b000f);
+static_assert(PPCInstructions::mtctr(PPCInstructions::R11) == 0x7d6903a6);
+static_assert(PPCInstructions::mfspr(PPCInstructions::R3, PPCInstructions::UPIR) == 0x7c6ffaa6);
+static_assert(PPCInstructions::slwi(PPCInstructions::R12, PPCInstructions::R12, 5) == 0x558c2834);
+static_assert(PPCInstructions::addis(PPCInstructions::R12, PPCInstructions::R12, 0x1012) == 0x3d8c1012);
+static_assert(PPCInstructions::beq(0x14) == 0x41820014);
+static_assert(PPCInstructions::ba(0x01000000) == 0x49000002);
+static_assert(PPCInstructions::b(-4) == 0x4bfffffc);
+static_assert(PPCInstructions::bl(0x100) == 0x48000101);
+static_assert(PPCInstructions::getBranchTarget(PPCInstructions::b(-4), 0x02000000) == 0x01FFFFFC);
+static_assert(PPCInstructions::getBranchTarget(PPCInstructions::ba(0x01000000), 0x02000000) == 0x01000000);
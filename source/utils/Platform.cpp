@@ -0,0 +1,136 @@
+#include "Platform.h"
+#include "KernelFindExport.h"
+#include <coreinit/cache.h>
+#include <coreinit/dynload.h>
+#include <coreinit/mcp.h>
+#include <coreinit/memorymap.h>
+#include <coreinit/thread.h>
+#include <coreinit/title.h>
+#include <kernel/kernel.h>
+#include <vector>
+
+uint32_t Platform::effectiveToPhysical(uint32_t effectiveAddress) {
+    // These hardcoded values should be replaced with something more dynamic.
+    if (effectiveAddress >= 0x00800000 && effectiveAddress < 0x01000000) {
+        return effectiveAddress + 0x30800000 - 0x00800000;
+    }
+    return (uint32_t) OSEffectiveToPhysical(effectiveAddress);
+}
+
+bool Platform::readPhysical(uint32_t physicalAddress, uint32_t *out) {
+    volatile uint32_t buffer;
+    auto bufferPhys = effectiveToPhysical((uint32_t) &buffer);
+    if (bufferPhys == 0) {
+        return false;
+    }
+    KernelCopyData(bufferPhys, physicalAddress, 4);
+    DCFlushRange((void *) &buffer, 4);
+    *out = buffer;
+    return true;
+}
+
+bool Platform::writePhysical(uint32_t physicalAddress, uint32_t value) {
+    volatile uint32_t buffer = value;
+    auto bufferPhys          = effectiveToPhysical((uint32_t) &buffer);
+    if (bufferPhys == 0) {
+        return false;
+    }
+    DCFlushRange((void *) &buffer, 4);
+    KernelCopyData(physicalAddress, bufferPhys, 4);
+    return true;
+}
+
+uint32_t Platform::readEffective(uint32_t effectiveAddress) {
+    return *((volatile uint32_t *) effectiveAddress);
+}
+
+void Platform::flushData(const void *address, uint32_t size) {
+    DCFlushRange((void *) address, size);
+}
+
+void Platform::invalidateInstructions(const void *address, uint32_t size) {
+    ICInvalidateRange((void *) address, size);
+}
+
+bool Platform::isModuleLoaded(const char *name, PlatformModule *outModule) {
+    OSDynLoad_Module module = nullptr;
+    if (OSDynLoad_IsModuleLoaded((char *) name, &module) != OS_DYNLOAD_OK || module == nullptr) {
+        return false;
+    }
+    *outModule = module;
+    return true;
+}
+
+uint32_t Platform::findFunctionExport(PlatformModule module, const char *name) {
+    uint32_t result = 0;
+    if (OSDynLoad_FindExport((OSDynLoad_Module) module, OS_DYNLOAD_EXPORT_FUNC, name, reinterpret_cast<void **>(&result)) != OS_DYNLOAD_OK) {
+        return 0;
+    }
+    return result;
+}
+
+uint32_t Platform::getNumberOfRPLs() {
+    auto result = OSDynLoad_GetNumberOfRPLs();
+    return result > 0 ? result : 0;
+}
+
+bool Platform::getRPLInfo(uint32_t first, uint32_t count, PlatformRPLInfo *outInfos) {
+    std::vector<OSDynLoad_NotifyData> infos(count);
+    if (!OSDynLoad_GetRPLInfo(first, count, infos.data())) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        outInfos[i] = {infos[i].name, infos[i].textAddr, infos[i].textSize};
+    }
+    return true;
+}
+
+uint32_t Platform::findExecutableExport(std::string_view rplName, std::string_view functionName) {
+    return KernelFindExport(rplName, functionName);
+}
+
+void Platform::findExecutableExports(std::span<PlatformExportRequest> requests) {
+    KernelFindExports(requests);
+}
+
+void Platform::resetExecutableExports(std::string_view moduleName) {
+    KernelFindExportResetIndex(moduleName);
+}
+
+void Platform::resetAllExecutableExports() {
+    KernelFindExportResetIndices();
+}
+
+uint32_t Platform::getUPIDAddress() {
+    // OSGetUPID starts with "lis r3, high; lwz r3, low(r3)".
+    auto high = ((uint32_t *) OSGetUPID)[0] & 0x0000FFFF;
+    auto low  = (int16_t) (((uint32_t *) OSGetUPID)[1] & 0x0000FFFF);
+    return (high << 16) + low;
+}
+
+uint32_t Platform::getUPID() {
+    return OSGetUPID();
+}
+
+uint64_t Platform::getTitleId() {
+    return OSGetTitleID();
+}
+
+std::optional<uint16_t> Platform::getTitleVersion(uint64_t titleId) {
+    auto mcpHandle = MCP_Open();
+    MCPTitleListType titleInfo;
+    int32_t res = -1;
+    if ((titleId & 0x0000000F00000000) == 0) {
+        // Prefer the version of the update.
+        res = MCP_GetTitleInfo(mcpHandle, titleId | 0x0000000E00000000, &titleInfo);
+    }
+    if (res != 0) {
+        res = MCP_GetTitleInfo(mcpHandle, titleId, &titleInfo);
+    }
+    MCP_Close(mcpHandle);
+
+    if (res != 0) {
+        return {};
+    }
+    return titleInfo.titleVersion;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+/**
+ * Handle of a loaded RPL, an OSDynLoad_Module on the console.
+ */
+typedef void *PlatformModule;
+
+/**
+ * The parts of OSDynLoad_NotifyData the patcher uses.
+ */
+typedef struct PlatformRPLInfo {
+    const char *name;
+    uint32_t textAddr;
+    uint32_t textSize;
+} PlatformRPLInfo;
+
+typedef struct PlatformExportRequest {
+    std::string_view rplName;
+    std::string_view functionName; // has to be null terminated
+    uint32_t address;              // 0 if the function could not be found
+} PlatformExportRequest;
+
+/**
+ * Thin wrapper around the console functions the patcher uses to read/write code, to look up loaded RPLs and
+ * to identify the running process.
+ *
+ * Everything outside of main.cpp goes through this class instead of calling the kernel/loader directly,
+ * so the patching logic can be run against simulated memory by linking another implementation of Platform.cpp (see host/).
+ * The header must not include any console headers.
+ */
+class Platform {
+public:
+    /**
+     * Returns 0 if the address is not mapped.
+     */
+    static uint32_t effectiveToPhysical(uint32_t effectiveAddress);
+
+    static bool readPhysical(uint32_t physicalAddress, uint32_t *out);
+
+    static bool writePhysical(uint32_t physicalAddress, uint32_t value);
+
+    /**
+     * Reads a word of code that is mapped for the current process.
+     */
+    static uint32_t readEffective(uint32_t effectiveAddress);
+
+    static void flushData(const void *address, uint32_t size);
+
+    static void invalidateInstructions(const void *address, uint32_t size);
+
+    /**
+     * Makes freshly written code visible to the instruction cache of the current core.
+     */
+    static void flushCode(const void *address, uint32_t size) {
+        flushData(address, size);
+        invalidateInstructions(address, size);
+    }
+
+    static bool isModuleLoaded(const char *name, PlatformModule *outModule);
+
+    /**
+     * Returns the address of an exported function, or 0 if it doesn't exist.
+     */
+    static uint32_t findFunctionExport(PlatformModule module, const char *name);
+
+    static uint32_t getNumberOfRPLs();
+
+    static bool getRPLInfo(uint32_t first, uint32_t count, PlatformRPLInfo *outInfos);
+
+    /**
+     * Looks up an export of any loaded RPL/RPX by name, even if it's loaded for another process.
+     * Returns 0 if it doesn't exist.
+     */
+    static uint32_t findExecutableExport(std::string_view rplName, std::string_view functionName);
+
+    /**
+     * Like findExecutableExport, but resolves many exports at once.
+     */
+    static void findExecutableExports(std::span<PlatformExportRequest> requests);
+
+    /**
+     * Forgets what has been looked up in an unloaded RPL/RPX.
+     */
+    static void resetExecutableExports(std::string_view moduleName);
+
+    static void resetAllExecutableExports();
+
+    /**
+     * Address of the word OSGetUPID reads the UPID of the current process from.
+     */
+    static uint32_t getUPIDAddress();
+
+    static uint32_t getUPID();
+
+    static uint64_t getTitleId();
+
+    /**
+     * Returns the version of the title (preferring its update), or an empty optional if it couldn't be determined.
+     */
+    static std::optional<uint16_t> getTitleVersion(uint64_t titleId);
+};
@@ -1,11 +1,18 @@
 #include "globals.h"
 
 char gJumpHeapData[JUMP_HEAP_DATA_SIZE] __attribute__((section(".data")));
-MEMHeapHandle gJumpHeapHandle __attribute__((section(".data")));
+TrampolineHeap gTrampolineHeap;
 
 std::shared_ptr<FunctionAddressProvider> gFunctionAddressProvider;
 std::recursive_mutex gPatchedFunctionsMutex;
 std::vector<std::shared_ptr<PatchedFunctionData>> gPatchedFunctions;
+PatchedFunctionHandleTable gPatchedFunctionHandles;
+PatchChainIndex gPatchChains;
+PendingPatchIndex gPendingPatches;
+TitlePatchIndex gTitlePatches;
+LoadedRPLIndex gLoadedRPLs;
+PatchStatistics gPatchStatistics;
+ProcessDispatcherIndex gProcessDispatchers(&gPatchStatistics);
 
 void *(*gMEMAllocFromDefaultHeapExForThreads)(uint32_t size, int align);
 void (*gMEMFreeToDefaultHeapForThreads)(void *ptr);
\ No newline at end of file
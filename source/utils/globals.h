@@ -1,7 +1,14 @@
 #pragma once
+#include "../LoadedRPLIndex.h"
+#include "../PatchChainIndex.h"
+#include "../PatchStatistics.h"
 #include "../PatchedFunctionData.h"
+#include "../PatchedFunctionHandleTable.h"
+#include "../PendingPatchIndex.h"
+#include "../ProcessDispatcherIndex.h"
+#include "../TrampolineHeap.h"
+#include "../TitlePatchIndex.h"
 #include "version.h"
-#include <coreinit/memheap.h>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -11,11 +18,18 @@
 
 #define JUMP_HEAP_DATA_SIZE (32 * 1024)
 extern char gJumpHeapData[];
-extern MEMHeapHandle gJumpHeapHandle;
+extern TrampolineHeap gTrampolineHeap;
 
 extern std::shared_ptr<FunctionAddressProvider> gFunctionAddressProvider;
 extern std::recursive_mutex gPatchedFunctionsMutex;
 extern std::vector<std::shared_ptr<PatchedFunctionData>> gPatchedFunctions;
+extern PatchedFunctionHandleTable gPatchedFunctionHandles;
+extern PatchChainIndex gPatchChains;
+extern PendingPatchIndex gPendingPatches;
+extern ProcessDispatcherIndex gProcessDispatchers;
+extern TitlePatchIndex gTitlePatches;
+extern LoadedRPLIndex gLoadedRPLs;
+extern PatchStatistics gPatchStatistics;
 
 extern void *(*gMEMAllocFromDefaultHeapExForThreads)(uint32_t size, int align);
 extern void (*gMEMFreeToDefaultHeapForThreads)(void *ptr);